@@ -3,18 +3,38 @@
 
 #include <ctype.h>
 #include <filesystem>
-#include <format>
 #include <fstream>
+#include <functional>
 #include <initializer_list>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <list>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <system_error>
+#include <unordered_set>
+#include <utility>
 #include <stdexcept>
+#include <vector>
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <concepts>
+#include <bit>
+#include <charconv>
 #include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define YJSON_SSE2 1
+#endif
 
 #ifdef max
 #undef max
@@ -36,20 +56,147 @@ class YJson final {
 
  public:
   explicit YJson(): _type(Null) {}
-  enum Type { False = 0, True = 1, Null, Number, String, Array, Object };
+  enum Type : uint8_t { False = 0, True = 1, Null, Number, String, Array, Object };
   enum Encode { UTF8, UTF8BOM };
-  typedef std::pair<std::u8string, YJson> ObjectItemType;
-  typedef std::list<ObjectItemType> ObjectType;
+
+  // Object key. Keys of up to 23 bytes are stored inline and longer ones on
+  // the heap. Keys parsed in situ borrow their bytes from the source buffer.
+  // Copies always own their bytes, and moves keep borrowing.
+  class Key {
+   public:
+    Key() noexcept { _bytes[tagIndex] = 0; }
+    Key(std::u8string_view str) { assign(str); }
+    Key(const char8_t* str) : Key(std::u8string_view(str)) {}
+    Key(const std::u8string& str) : Key(std::u8string_view(str)) {}
+    // A key too long to be inline is borrowed from a KeyTable, which lends
+    // the copy it already has, or copied into an Arena and borrowed from
+    // there. Any other resource would never get the bytes back, so the key
+    // owns them.
+    Key(std::u8string_view str, std::pmr::memory_resource& resource) {
+      const char8_t* data = nullptr;
+      if (str.size() > tagIndex && &resource != std::pmr::get_default_resource())
+        data = store(str, resource);
+      if (data) {
+        setExternal(data, str.size(), borrowedTag);
+      } else {
+        assign(str);
+      }
+    }
+    Key(const Key& other) { assign(other); }
+    Key(Key&& other) noexcept {
+      std::memcpy(_bytes, other._bytes, sizeof _bytes);
+      other._bytes[tagIndex] = 0;
+    }
+    ~Key() { release(); }
+
+    Key& operator=(const Key& other) {
+      return *this = Key(other);
+    }
+    Key& operator=(Key&& other) noexcept {
+      if (this != &other) {
+        release();
+        std::memcpy(_bytes, other._bytes, sizeof _bytes);
+        other._bytes[tagIndex] = 0;
+      }
+      return *this;
+    }
+
+    static Key borrow(std::u8string_view str) noexcept {
+      Key key;
+      key.setExternal(str.data(), str.size(), borrowedTag);
+      return key;
+    }
+
+    const char8_t* data() const noexcept {
+      return isExternal() ? externalData() : _bytes;
+    }
+    size_t size() const noexcept {
+      return isExternal() ? externalSize() : _bytes[tagIndex];
+    }
+    bool empty() const noexcept { return size() == 0; }
+    bool borrowed() const noexcept { return _bytes[tagIndex] == borrowedTag; }
+    const char8_t* begin() const noexcept { return data(); }
+    const char8_t* end() const noexcept { return data() + size(); }
+    std::u8string str() const { return std::u8string(data(), size()); }
+    operator std::u8string_view() const noexcept {
+      return std::u8string_view(data(), size());
+    }
+
+    // Keys lent by the same KeyTable are equal by address.
+    friend bool operator==(const Key& key, std::u8string_view str) noexcept {
+      const std::u8string_view view(key);
+      return view.size() == str.size() && (view.data() == str.data() || view == str);
+    }
+    friend auto operator<=>(const Key& key, std::u8string_view str) noexcept {
+      return std::u8string_view(key) <=> str;
+    }
+
+   private:
+    static constexpr size_t tagIndex = 23;
+    static constexpr char8_t heapTag = 0x80;
+    static constexpr char8_t borrowedTag = 0x81;
+
+    bool isExternal() const noexcept { return _bytes[tagIndex] & 0x80; }
+    const char8_t* externalData() const noexcept {
+      const char8_t* data;
+      std::memcpy(&data, _bytes, sizeof data);
+      return data;
+    }
+    size_t externalSize() const noexcept {
+      size_t size;
+      std::memcpy(&size, _bytes + sizeof(const char8_t*), sizeof size);
+      return size;
+    }
+    // Null unless resource is a KeyTable or an Arena.
+    static const char8_t* store(std::u8string_view str, std::pmr::memory_resource& resource);
+    void setExternal(const char8_t* data, size_t size, char8_t tag) noexcept {
+      std::memcpy(_bytes, &data, sizeof data);
+      std::memcpy(_bytes + sizeof data, &size, sizeof size);
+      _bytes[tagIndex] = tag;
+    }
+
+    void assign(std::u8string_view str) {
+      if (str.size() <= tagIndex) {
+        std::memcpy(_bytes, str.data(), str.size());
+        _bytes[tagIndex] = static_cast<char8_t>(str.size());
+      } else {
+        char8_t* data = new char8_t[str.size()];
+        std::memcpy(data, str.data(), str.size());
+        setExternal(data, str.size(), heapTag);
+      }
+    }
+    void release() noexcept {
+      if (_bytes[tagIndex] == heapTag)
+        delete[] externalData();
+    }
+
+    // Inline bytes, or a pointer and a size; the last byte is the tag, which
+    // holds the inline size or one of the two external tags.
+    alignas(const char8_t*) char8_t _bytes[24];
+  };
+
+  typedef std::pair<Key, YJson> ObjectItemType;
+  // Kept in insertion order. Objects with many keys also get a hash index,
+  // which find() and operator[] use; rename a key with remove() and append()
+  // rather than through an iterator, or the index will not see it.
+  typedef std::pmr::list<ObjectItemType> ObjectType;
   typedef ObjectType::iterator ObjectIterator;
   typedef ObjectType::const_iterator ObjectConstIterator;
   typedef YJson ArrayItemType;
-  typedef std::list<ArrayItemType> ArrayType;
+  // Contiguous, so indexing is O(1). As with any std::vector, append and
+  // remove invalidate iterators and references to the elements after them;
+  // hold an index rather than an ArrayIterator across them.
+  typedef std::pmr::vector<ArrayItemType> ArrayType;
   typedef ArrayType::iterator ArrayIterator;
   typedef ArrayType::const_iterator ArrayConstIterator;
 
  private:
   // typedef std::u8string_view::const_iterator StrIterator;
 
+  template <typename _Iterator>
+  static constexpr bool isByteRange = std::contiguous_iterator<_Iterator> &&
+                                      sizeof(std::iter_value_t<_Iterator>) == 1;
+
   template <typename StrIterator>
   static StrIterator StrSkip(StrIterator first, StrIterator last) {
     while (first != last && static_cast<char8_t>(*first) <= 32)
@@ -61,54 +208,60 @@ class YJson final {
   YJson(Type type) : _type(type) {
     switch (type) {
       case YJson::Object:
-        _value.Object = new ObjectType;
+        _value.Object = newContainer(ObjectType());
         break;
       case YJson::Array:
-        _value.Array = new ArrayType;
+        _value.Array = newContainer(ArrayType());
         break;
       case YJson::String:
-        _value.String = new std::u8string;
+        setString(std::u8string_view());
         break;
       case YJson::Number:
-        _value.Double = new double(0);
+        _value.Double = 0;
       default:
         break;
     }
   }
   YJson(double val) : _type(YJson::Number) {
-    _value.Double = new double(val);
+    _value.Double = val;
   }
-  YJson(int val) : YJson(static_cast<double>(val)) {}
+  template <std::integral _Ty>
+  YJson(_Ty val) : _type(YJson::Number) { setInteger(val); }
   YJson(std::u8string str) : _type(YJson::String) {
-    _value.String = new std::u8string(std::move(str));
+    setString(std::move(str));
   }
   YJson(std::u8string_view str) : _type(YJson::String) {
-    _value.String = new std::u8string(str.begin(), str.end());
+    setString(str);
   }
   YJson(const char8_t* str) : YJson(std::u8string_view(str)) {}
   YJson(bool val) : _type(val ? YJson::True : YJson::False) {}
   YJson(std::nullptr_t) : _type(YJson::Null) {}
   YJson(ArrayType array) : _type(YJson::Array) {
-    _value.Array = new ArrayType(std::move(array));
+    _value.Array = newContainer(std::move(array));
   }
   YJson(ObjectType object) : _type(YJson::Object) {
-    _value.Object = new ObjectType(std::move(object));
+    setObject(newContainer(std::move(object)));
   }
+  // Arrays and objects are shared with other until either is changed, unless
+  // they are pinned or have just lent out references.
   YJson(const YJson& other) : _type(other._type) {
     switch (_type) {
       case YJson::Array:
-        _value.Array = new ArrayType(other._value.Array->begin(),
-                                     other._value.Array->end());
+        if (!share(other))
+          _value.Array = newContainer(ArrayType(other._value.Array->begin(),
+                                                other._value.Array->end()));
         break;
       case YJson::Object:
-        _value.Object = new ObjectType(other._value.Object->begin(),
-                                       other._value.Object->end());
+        if (!share(other))
+          setObject(newContainer(ObjectType(other._value.Object->begin(),
+                                            other._value.Object->end())));
         break;
       case YJson::String:
-        _value.String = new std::u8string(*other._value.String);
+        setString(other.stringView());
         break;
       case YJson::Number:
-        _value.Double = new double(*other._value.Double);
+        _storage = other._storage;
+        _value = other._value;
         break;
       default:
         break;
@@ -116,8 +269,9 @@ class YJson final {
   }
 
   YJson(YJson&& other) noexcept
-    : _type(other._type)
+    : _type(other._type), _storage(other._storage), _size(other._size)
   {
+    std::copy_n(other._text, sizeof _text, _text);
     _value = other._value;
     // other._value = nullptr;
     other._type = YJson::Null;
@@ -128,21 +282,74 @@ class YJson final {
     if (first >= last) {
       throw std::logic_error("YJson Error: The iterator range is wrong.");
     }
-    parseValue(StrSkip(first, last), last);
+    parseDocument(first, last);
   }
   YJson(const char8_t* first, size_t size): YJson(first, first + size) {}
 
+  struct InSitu { explicit InSitu() = default; };
+  static constexpr InSitu inSitu {};
+
+  // In-situ parsing: strings and keys point straight into the buffer, and
+  // escaped ones are decoded in place, so the buffer is modified and must
+  // outlive the tree and every value moved out of it. Copies own their text.
+  // Containers are allocated from resource. Use YJson::Document to have the
+  // buffer owned for you.
+  YJson(InSitu, char8_t* first, char8_t* last,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource()): YJson() {
+    if (first >= last) {
+      throw std::logic_error("YJson Error: The iterator range is wrong.");
+    }
+    parseValue(StrSkip(first, last), last, resource);
+  }
+  YJson(InSitu, std::u8string& json,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : YJson(inSitu, json.data(), json.data() + json.size(), resource) {}
+
+  struct Parallel { explicit Parallel() = default; };
+  static constexpr Parallel parallel {};
+
+  // Parses a top-level array on `threads` threads, or one per core if 0. The
+  // elements are cut into runs at top-level commas, the runs are parsed at
+  // the same time and joined in order, and the tree is the one the serial
+  // parser builds. Other documents, and any run that fails, are parsed
+  // serially, so errors are the serial parser's too.
+  YJson(Parallel, const char8_t* first, const char8_t* last, unsigned threads = 0);
+  YJson(Parallel, const std::filesystem::path& path, unsigned threads = 0);
+
+  // Builds the tree in a memory resource such as a YJson::Arena: containers
+  // are allocated from it, and so are strings and keys too long to be inline
+  // if it is an Arena, so it must outlive the tree and any value moved out of
+  // it. A KeyTable lends long keys and takes containers from upstream. The copy
+  // constructor copies back to the heap; the second form copies into one.
+  YJson(std::pmr::memory_resource* resource, const char8_t* first, const char8_t* last);
+  YJson(std::pmr::memory_resource* resource, const YJson& other);
+
+  class Document;
+  class PushParser;
+  class Lazy;
+  class Arena;
+  class KeyTable;
+  class Tape;
+  struct Compact;
+  template <typename _Sink, typename _Policy = Compact>
+  class Writer;
+  template <typename _Sink>
+  Writer(_Sink&) -> Writer<_Sink>;
+  class FileSink;
+  class AtomicFile;
+
   typedef std::initializer_list<std::pair<std::u8string_view, YJson>> O;
   YJson(YJson::O lst) : _type(YJson::Type::Object) {
-    _value.Object = new ObjectType;
+    const auto object = newContainer(ObjectType());
     for (auto& [i, j] : lst) {
-      _value.Object->emplace_back(i, j);
+      object->emplace_back(i, j);
     }
+    setObject(object);
   }
 
   typedef std::initializer_list<YJson> A;
   YJson(YJson::A lst) : _type(YJson::Array) {
-    _value.Array = new ArrayType;
+    _value.Array = newContainer(ArrayType());
     for (auto& i : lst) {
       _value.Array->emplace_back(i);
     }
@@ -154,16 +361,53 @@ class YJson final {
   YJson::Type& getType() { return _type; }
   const YJson::Type& getType() const { return const_cast<YJson*>(this)->getType(); }
 
-  std::u8string& getValueString() { return *_value.String; }
-  const std::u8string& getValueString() const { return const_cast<YJson*>(this)->getValueString(); }
+  // The mutable form, for editing in place, first moves a string held inline
+  // or borrowed from an in-situ buffer to the heap. A const node is never
+  // changed, as other threads may be reading it, so the const form returns a
+  // copy; being const, it still binds to const std::u8string& and auto&.
+  // getValueStringView() reads either without copying.
+  std::u8string& getValueString() {
+    if (_storage != Default) {
+      const auto str = new std::u8string(stringView());
+      _storage = Default;
+      _value.String = str;
+    }
+    return *_value.String;
+  }
+  const std::u8string getValueString() const { return std::u8string(stringView()); }
+  std::u8string_view getValueStringView() const { return stringView(); }
   template<typename _Ty=int32_t>
-  _Ty getValueInt() const { return static_cast<_Ty>(*_value.Double); }
-  double& getValueDouble() { return *_value.Double; }
-  const double& getValueDouble() const { return const_cast<YJson*>(this)->getValueDouble(); }
-  ObjectType& getObject() { return *_value.Object; }
-  const ObjectType& getObject() const { return const_cast<YJson*>(this)->getObject(); }
-  ArrayType& getArray() { return *_value.Array; }
-  const ArrayType& getArray() const { return const_cast<YJson*>(this)->getArray(); }
+  _Ty getValueInt() const {
+    switch (_storage) {
+      case Int64: return static_cast<_Ty>(_value.Int);
+      case UInt64: return static_cast<_Ty>(_value.UInt);
+      default: return static_cast<_Ty>(_value.Double);
+    }
+  }
+  // Asking for a writable double turns an integer node into a double one.
+  // The const form converts a copy and keeps the node exact.
+  double& getValueDouble() {
+    if (_storage != Default) {
+      _value.Double = numberValue();
+      _storage = Default;
+    }
+    return _value.Double;
+  }
+  double getValueDouble() const { return numberValue(); }
+  // The index is marked stale, as the caller may change the keys, and is
+  // built again by the next lookup or insertion through YJson.
+  ObjectType& getObject() {
+    lend();
+    if (_storage == Indexed)
+      dropIndex();
+    return *_value.Object;
+  }
+  const ObjectType& getObject() const { return *_value.Object; }
+  ArrayType& getArray() {
+    lend();
+    return *_value.Array;
+  }
+  const ArrayType& getArray() const { return *_value.Array; }
 
   static unsigned char _toHex(unsigned char x) {
     constexpr int A = 'A' - 10;
@@ -183,16 +427,26 @@ class YJson final {
     return y;
   }
 
-  void popBackA() { _value.Array->pop_back(); }
+  void popBackA() {
+    detach();
+    _value.Array->pop_back();
+  }
 
-  void popBackO() { _value.Object->pop_back(); }
+  void popBackO() {
+    detach();
+    if (_storage == Indexed)
+      unindexItem(std::prev(_value.Object->end()));
+    _value.Object->pop_back();
+  }
 
   template <typename _Iterator>
   void assignA(_Iterator first, _Iterator last) {
     if (_type != YJson::Array) {
       clearData();
       _type = YJson::Array;
-      _value.Array = new ArrayType;
+      _value.Array = newContainer(ArrayType());
+    } else {
+      detach();
     }
     _value.Array->assign(first, last);
   }
@@ -243,58 +497,102 @@ class YJson final {
   size_t sizeA() const { return _value.Array->size(); }
   size_t sizeO() const { return _value.Object->size(); }
 
-  std::u8string toString(bool fmt = false) const {
-    std::ostringstream result;
-    if (fmt) {
-      printValue(result, 0);
+  // Collects what the printers write in a string, with no stream between;
+  // toString() prints through one.
+  class StringSink {
+   public:
+    explicit StringSink(std::u8string& str) : _str(str) {}
+    void put(char c) { _str.push_back(static_cast<char8_t>(c)); }
+    void write(const char* data, size_t size) {
+      _str.append(reinterpret_cast<const char8_t*>(data), size);
+    }
+
+   private:
+    std::u8string& _str;
+  };
+
+  // Layouts for print() and toString(). A policy derives from one of these
+  // and overrides what differs, e.g. for output that is the same for equal
+  // trees, to use as a cache key:
+  //
+  //   struct Sorted: YJson::Compact { static constexpr bool sortKeys = true; };
+  //   json.toString<Sorted>();
+  struct Compact {
+    // Indent chars per level; 0 puts everything on one line.
+    static constexpr int indent = 0;
+    static constexpr char indentChar = ' ';
+    static constexpr std::string_view newline = "\n";
+    static constexpr bool sortKeys = false;
+    // Writes everything past U+007F as \u escapes.
+    static constexpr bool ascii = false;
+    // Significant digits for doubles; 0 is the shortest that reads back.
+    static constexpr int precision = 0;
+  };
+  struct Pretty: Compact {
+    static constexpr int indent = 4;
+  };
+  struct CompactAscii: Compact {
+    static constexpr bool ascii = true;
+  };
+  struct PrettyAscii: Pretty {
+    static constexpr bool ascii = true;
+  };
+
+  // Prints to any sink with put(char) and write(const char*, size), such as
+  // a StringSink or a std::ostream.
+  template <typename _Policy = Compact, typename _Sink>
+  void print(_Sink& sink) const {
+    printValue<_Policy>(sink, 0);
+  }
+  template <typename _Sink>
+  void print(_Sink& sink, bool fmt, bool ascii = false) const {
+    if (ascii) {
+      fmt ? print<PrettyAscii>(sink) : print<CompactAscii>(sink);
     } else {
-      printValue(result);
+      fmt ? print<Pretty>(sink) : print<Compact>(sink);
     }
-    const std::string str = result.str();
-    return std::u8string(str.begin(), str.end());
   }
 
-  bool toFile(const std::filesystem::path& file_name,
+  template <typename _Policy>
+  std::u8string toString() const {
+    std::u8string result;
+    StringSink sink(result);
+    print<_Policy>(sink);
+    return result;
+  }
+  std::u8string toString(bool fmt = false, bool ascii = false) const {
+    std::u8string result;
+    StringSink sink(result);
+    print(sink, fmt, ascii);
+    return result;
+  }
+
+  // What toFile() did: the size of the new file, or the error that left
+  // the old one as it was. Tests true on success.
+  struct WriteResult {
+    size_t bytes = 0;
+    std::error_code error;
+    operator bool() const { return !error; }
+  };
+
+  // Prints into a temporary file beside file_name through a large buffer
+  // and renames it over file_name, so a crash leaves the old file or the
+  // whole new one. With sync, the data is on disk before the rename.
+  template <typename _Policy>
+  WriteResult toFile(const std::filesystem::path& file_name,
+                     const Encode& encode = UTF8, bool sync = false) const;
+  WriteResult toFile(const std::filesystem::path& file_name,
                      bool fmt = true,
-                     const Encode& encode = UTF8) {
-    std::ofstream result(file_name, std::ios::out | std::ios::binary);
-    if (!result.is_open()) {
-      return false;
-    }
-    if (encode == UTF8BOM) {
-      result.write(reinterpret_cast<const char*>(utf8bom.data()), 3);
-    }
-    if (fmt) {
-      printValue(result, 0);
-    } else {
-      printValue(result);
-    }
-    result.close();
-    return true;
+                     const Encode& encode = UTF8, bool sync = false) const {
+    return fmt ? toFile<Pretty>(file_name, encode, sync)
+               : toFile<Compact>(file_name, encode, sync);
   }
 
+  // Copies first, so other may be a value inside this one.
   YJson& operator=(const YJson& other) {
-    if (this == &other)
-      return *this;
-    clearData();
-    _type = other._type;
-    switch (_type) {
-      case YJson::Array:
-        _value.Array = new ArrayType(other._value.Array->begin(),
-                                     other._value.Array->end());
-        break;
-      case YJson::Object:
-        _value.Object = new ObjectType(other._value.Object->begin(),
-                                       other._value.Object->end());
-        break;
-      case YJson::String:
-        _value.String = new std::u8string(*other._value.String);
-        break;
-      case YJson::Number:
-        _value.Double = new double(*other._value.Double);
-        break;
-      default:
-        break;
+    if (this != &other) {
+      YJson copy(other);
+      swap(copy);
     }
     return *this;
   }
@@ -307,7 +605,7 @@ class YJson final {
   YJson& operator=(std::u8string str) {
     clearData();
     _type = YJson::String;
-    _value.String = new std::u8string(std::move(str));
+    setString(std::move(str));
     return *this;
   }
 
@@ -323,12 +621,16 @@ class YJson final {
   YJson& operator=(double val) {
     clearData();
     _type = YJson::Number;
-    _value.Double = new double(val);
+    _value.Double = val;
     return *this;
   }
 
-  YJson& operator=(int val) {
-    return this->operator=(static_cast<double>(val));
+  template <std::integral _Ty>
+  YJson& operator=(_Ty val) {
+    clearData();
+    _type = YJson::Number;
+    setInteger(val);
+    return *this;
   }
 
   YJson& operator=(bool val) {
@@ -347,16 +649,16 @@ class YJson final {
     clearData();
     switch (_type = type) {
       case YJson::Object:
-        _value.Object = new ObjectType;
+        _value.Object = newContainer(ObjectType());
         break;
       case YJson::Array:
-        _value.Array = new ArrayType;
+        _value.Array = newContainer(ArrayType());
         break;
       case YJson::String:
-        _value.String = new std::u8string;
+        setString(std::u8string_view());
         break;
       case YJson::Number:
-        _value.Double = new double(0);
+        _value.Double = 0;
       default:
         break;
     }
@@ -365,34 +667,32 @@ class YJson final {
   }
 
   ArrayItemType& operator[](size_t i) { return *find(i); }
-  const ArrayItemType& operator[](size_t i) const { return const_cast<YJson*>(this)->operator[](i); }
+  const ArrayItemType& operator[](size_t i) const { return *find(i); }
 
-  ArrayItemType& operator[](int i) { return const_cast<YJson*>(this)->operator[](static_cast<size_t>(i)); }
-  const ArrayItemType& operator[](int i) const { return const_cast<YJson*>(this)->operator[](i); }
+  ArrayItemType& operator[](int i) { return operator[](static_cast<size_t>(i)); }
+  const ArrayItemType& operator[](int i) const { return operator[](static_cast<size_t>(i)); }
 
   ArrayItemType& operator[](const char8_t* key) {
-    auto itr = find(key);
-    if (itr == _value.Object->end()) {
-      return _value.Object->emplace(itr, key, YJson::Null)->second;
-    } else {
-      return itr->second;
-    }
+    return operator[](std::u8string_view(key));
   }
 
   const ArrayItemType& operator[](const char8_t* key) const {
-    return const_cast<YJson *>(this)->operator[](key);
+    return operator[](std::u8string_view(key));
   }
 
   ArrayItemType& operator[](const std::u8string_view key) {
     auto itr = find(key);
     if (itr == _value.Object->end()) {
-      return _value.Object->emplace(itr, key, YJson::Null)->second;
-    } else {
-      return itr->second;
+      itr = _value.Object->emplace(itr, Key(key, *_value.Object->get_allocator().resource()), YJson::Null);
+      indexItem(itr);
     }
+    return itr->second;
   }
+  // A missing key reads as null, and is not added.
   const ArrayItemType& operator[](const std::u8string_view key) const {
-    return const_cast<YJson*>(this)->operator[](key);
+    static const YJson null;
+    const auto itr = find(key);
+    return itr == _value.Object->end() ? null : itr->second;
   }
 
   bool operator==(const YJson& other) const {
@@ -402,13 +702,13 @@ class YJson final {
       return false;
     switch (_type) {
       case YJson::Array:
-        return *_value.Array == *other._value.Array;
+        return _value.Array == other._value.Array || *_value.Array == *other._value.Array;
       case YJson::Object:
-        return *_value.Object == *other._value.Object;
+        return _value.Object == other._value.Object || *_value.Object == *other._value.Object;
       case YJson::Number:
-        return *_value.Double == *other._value.Double;
+        return numberEquals(other);
       case YJson::String:
-        return *_value.String == *other._value.String;
+        return stringView() == other.stringView();
       case YJson::Null:
       case YJson::False:
       case YJson::True:
@@ -423,32 +723,27 @@ class YJson final {
   bool operator==(std::nullptr_t) const {
     return _type == YJson::Null;
   }
-  bool operator==(int val) const {
-    if (_type != YJson::Number)
-      return false;
-    return fabs((double)val - *_value.Double) <=
-           std::numeric_limits<double>::epsilon();
-  }
-  bool operator!=(int val) const {
-    if (_type != YJson::Number)
-      return true;
-    return fabs(val - *_value.Double) > std::numeric_limits<double>::epsilon();
+  template <std::integral _Ty>
+  bool operator==(_Ty val) const {
+    return _type == YJson::Number && numberEquals(val);
   }
+  template <std::integral _Ty>
+  bool operator!=(_Ty val) const { return !operator==(val); }
   bool operator==(const std::u8string_view str) const {
-    return _type == YJson::String && *_value.String == str;
+    return _type == YJson::String && stringView() == str;
   }
   bool operator==(const std::u8string& str) const {
-    return _type == YJson::String && *_value.String == str;
+    return _type == YJson::String && stringView() == str;
   }
   bool operator==(const char8_t* str) const {
-    return _type == YJson::String && *_value.String == str;
+    return _type == YJson::String && stringView() == str;
   }
 
   void setText(std::u8string val) {
-    if (_type != YJson::String) {
+    if (_type != YJson::String || _storage != Default) {
       clearData();
       _type = YJson::String;
-      _value.String = new std::u8string(std::move(val));
+      setString(std::move(val));
     } else {
       _value.String->swap(val);
     }
@@ -456,10 +751,10 @@ class YJson final {
 
   template <typename _Iterator>
   void setText(_Iterator first, _Iterator last) {
-    if (_type != YJson::String) {
+    if (_type != YJson::String || _storage != Default) {
       clearData();
       _type = YJson::String;
-      _value.String = new std::u8string(first, last);
+      setString(std::u8string(first, last));
     } else {
       _value.String->assign(first, last);
     }
@@ -467,22 +762,23 @@ class YJson final {
 
   template <typename _Ty>
   void setText(const _Ty& utf8Array) {
-    if (_type != YJson::String) {
-      clearData();
-      _type = YJson::String;
-    } else {
-      delete _value.String;
-    }
-    _value.String = new std::u8string(utf8Array.begin(), utf8Array.end());
+    clearData();
+    _type = YJson::String;
+    setString(std::u8string(utf8Array.begin(), utf8Array.end()));
   }
 
   void setValue(double val) {
     clearData();
     _type = YJson::Number;
-    _value.Double = new double(val);
+    _value.Double = val;
   }
 
-  void setValue(int val) { setValue(static_cast<double>(val)); }
+  template <std::integral _Ty>
+  void setValue(_Ty val) {
+    clearData();
+    _type = YJson::Number;
+    setInteger(val);
+  }
 
   void setValue(bool val) {
     clearData();
@@ -500,29 +796,29 @@ class YJson final {
   YJson& joinO(const YJson& js);
   YJson& join(const YJson& js);
 
+  // The mutable forms lend() first, as what they find may be changed.
   ArrayIterator find(size_t index) {
-    auto iter = _value.Array->begin();
-    while (index-- && iter != _value.Array->end())
-      ++iter;
-    return iter;
+    lend();
+    return std::as_const(*this).find(index);
   }
   const ArrayIterator find(size_t index) const {
-    auto iter = _value.Array->begin();
-    while (index-- && iter != _value.Array->end())
-      ++iter;
-    return iter;
+    return index < _value.Array->size() ? _value.Array->begin() + index : _value.Array->end();
   }
-  ArrayIterator findByValA(int value) {
-    return findByValA(static_cast<double>(value));
+  template <std::integral _Ty>
+  ArrayIterator findByValA(_Ty value) {
+    lend();
+    return std::find(_value.Array->begin(), _value.Array->end(), value);
   }
-  const ArrayIterator findByValA(int value) const {
-    return findByValA(static_cast<double>(value));
+  template <std::integral _Ty>
+  const ArrayIterator findByValA(_Ty value) const {
+    return std::find(_value.Array->begin(), _value.Array->end(), value);
   }
   ArrayIterator findByValA(double value) {
+    lend();
     return std::find_if(_value.Array->begin(), _value.Array->end(),
                         [value](const YJson& item) {
                           return item._type == YJson::Number &&
-                                 fabs(value - *item._value.Double) <=
+                                 fabs(value - item.numberValue()) <=
                                      std::numeric_limits<double>::epsilon();
                         });
   }
@@ -530,11 +826,12 @@ class YJson final {
     return std::find_if(_value.Array->begin(), _value.Array->end(),
                         [value](const YJson& item) {
                           return item._type == YJson::Number &&
-                                 fabs(value - *item._value.Double) <=
+                                 fabs(value - item.numberValue()) <=
                                      std::numeric_limits<double>::epsilon();
                         });
   }
   ArrayIterator findByValA(const std::u8string_view str) {
+    lend();
     return std::find(_value.Array->begin(), _value.Array->end(), str);
   }
   const ArrayIterator findByValA(const std::u8string_view str) const {
@@ -543,14 +840,25 @@ class YJson final {
 
   template <typename _Ty = const std::u8string_view>
   ArrayIterator append(_Ty value) {
+    lend();
     return _value.Array->emplace(_value.Array->end(), value);
   }
 
   ArrayIterator append(YJson&& value) {
+    lend();
     return _value.Array->emplace(_value.Array->end(), std::move(value));
   }
 
-  ArrayIterator remove(ArrayIterator item) { return _value.Array->erase(item); }
+  // An iterator taken before the array was copied is moved to the clone.
+  ArrayIterator remove(ArrayIterator item) {
+    if (shared().refs.load(std::memory_order_acquire) > 1) {
+      const auto offset = item - _value.Array->begin();
+      detach();
+      item = _value.Array->begin() + offset;
+    }
+    lend();
+    return _value.Array->erase(item);
+  }
   ArrayIterator removeA(size_t index) { return remove(find(index)); }
   template <typename _Ty>
   ArrayIterator removeByValA(_Ty str) {
@@ -559,12 +867,12 @@ class YJson final {
   }
 
   ObjectIterator find(const std::u8string_view key) {
-    return std::find_if(_value.Object->begin(), _value.Object->end(),
-                        [&key](const YJson::ObjectItemType& item) {
-                          return item.first == key;
-                        });
+    lend();
+    return std::as_const(*this).find(key);
   }
   const ObjectIterator find(const std::u8string_view key) const {
+    if (_storage == Indexed)
+      return findIndexed(key);
     return std::find_if(_value.Object->begin(), _value.Object->end(),
                         [&key](const YJson::ObjectItemType& item) {
                           return item.first == key;
@@ -577,18 +885,20 @@ class YJson final {
     return find(std::u8string_view(key));
   }
   ObjectIterator findByValO(double value) {
+    lend();
     return std::find_if(_value.Object->begin(), _value.Object->end(),
                         [&value](const YJson::ObjectItemType& item) {
                           return item.second._type == YJson::Number &&
-                                 fabs(value - *item.second._value.Double) <=
+                                 fabs(value - item.second.numberValue()) <=
                                      std::numeric_limits<double>::epsilon();
                         });
   }
   ObjectIterator findByValO(const std::u8string_view str) {
+    lend();
     return std::find_if(_value.Object->begin(), _value.Object->end(),
                         [&str](const YJson::ObjectItemType& item) {
                           return item.second._type == YJson::String &&
-                                 *item.second._value.String == str;
+                                 item.second.stringView() == str;
                         });
   }
   ObjectIterator findByValO(int value) {
@@ -597,7 +907,11 @@ class YJson final {
 
   template <typename _Ty = const std::u8string_view>
   ObjectIterator append(_Ty value, const std::u8string_view key) {
-    return _value.Object->emplace(_value.Object->end(), key, value);
+    lend();
+    const auto iter = _value.Object->emplace(_value.Object->end(),
+        Key(key, *_value.Object->get_allocator().resource()), value);
+    indexItem(iter);
+    return iter;
   }
 
   ObjectIterator remove(const std::u8string_view key) {
@@ -605,6 +919,14 @@ class YJson final {
   }
   ObjectIterator remove(const char8_t* key) { return remove(find(key)); }
   ObjectIterator remove(ObjectIterator item) {
+    if (shared().refs.load(std::memory_order_acquire) > 1) {
+      const auto offset = std::distance(_value.Object->begin(), item);
+      detach();
+      item = std::next(_value.Object->begin(), offset);
+    }
+    lend();
+    if (_storage == Indexed)
+      unindexItem(item);
     return _value.Object->erase(item);
   }
   template <typename _Ty>
@@ -615,14 +937,65 @@ class YJson final {
 
   static bool isUtf8BomFile(const std::filesystem::path& path);
 
+  // JSON Lines (NDJSON): one value per line, and blank lines are skipped. The
+  // text is cut into chunks at line breaks, and the chunks are parsed on
+  // `threads` threads, or one per core if 0. Values come out in input order.
+  // The first bad line throws once every line before it has been delivered,
+  // and the message gives its line number.
+  typedef std::function<void(size_t line, YJson&& value)> LineCallback;
+  static void parseLines(const char8_t* first, const char8_t* last,
+                         const LineCallback& callback, unsigned threads = 0);
+  static void parseLines(const std::filesystem::path& path,
+                         const LineCallback& callback, unsigned threads = 0);
+  static std::vector<YJson> parseLines(const char8_t* first, const char8_t* last,
+                                       unsigned threads = 0);
+  static std::vector<YJson> parseLines(const std::filesystem::path& path,
+                                       unsigned threads = 0);
+
+  // Base for saxParse handlers. Every event is accepted and ignored, so a
+  // handler only defines the ones it needs. Returning false stops the parse.
+  // A handler that also defines onInteger(int64_t) and onUnsigned(uint64_t)
+  // gets integer literals that fit in 64 bits through them, exactly.
+  struct SaxHandler {
+    bool onNull() { return true; }
+    bool onBool(bool) { return true; }
+    bool onNumber(double) { return true; }
+    bool onString(std::u8string_view) { return true; }
+    bool onKey(std::u8string_view) { return true; }
+    bool onStartObject() { return true; }
+    bool onEndObject() { return true; }
+    bool onStartArray() { return true; }
+    bool onEndArray() { return true; }
+  };
+
+  // Parses [first, last) without building a tree, reporting each value to
+  // handler as it is read. Strings and keys are views that are only valid
+  // during the call. Returns false if the handler stopped the parse.
+  template <typename Handler, typename _Iterator>
+  static bool saxParse(_Iterator first, _Iterator last, Handler& handler) {
+    if (first >= last) {
+      throw std::logic_error("YJson Error: The iterator range is wrong.");
+    }
+    std::u8string buffer;
+    if constexpr (isByteRange<_Iterator>) {
+      const auto data = reinterpret_cast<const char8_t*>(std::to_address(first));
+      const auto end = data + (last - first);
+      auto iter = StrSkip(data, end);
+      return saxValue(handler, iter, end, buffer);
+    } else {
+      first = StrSkip(first, last);
+      return saxValue(handler, first, last, buffer);
+    }
+  }
+
   static void swap(YJson& A, YJson& B) {
     std::swap(A._type, B._type);
+    std::swap(A._storage, B._storage);
+    std::swap(A._text, B._text);
+    std::swap(A._size, B._size);
     std::swap(A._value, B._value);
   }
-  void swap(YJson& other) {
-    std::swap(_type, other._type);
-    std::swap(_value, other._value);
-  }
+  void swap(YJson& other) { swap(*this, other); }
 
   bool isArray() const { return _type == Array; }
   bool isObject() const { return _type == Object; }
@@ -635,17 +1008,41 @@ class YJson final {
   bool emptyA() const { return _value.Array->empty(); }
   bool emptyO() const { return _value.Object->empty(); }
 
-  void clearA() { _value.Array->clear(); }
-  void clearO() { _value.Object->clear(); }
+  void clearA() {
+    detach();
+    _value.Array->clear();
+  }
+  void reserveA(size_t size) {
+    detach();
+    _value.Array->reserve(size);
+  }
+  void clearO() {
+    detach();
+    _value.Object->clear();
+    if (_storage == Indexed)
+      dropIndex();
+  }
   YJson copy() const { return YJson(*this); }
-  ArrayIterator beginA() { return _value.Array->begin(); }
-  ObjectIterator beginO() { return _value.Object->begin(); }
-  ArrayIterator endA() { return _value.Array->end(); }
-  ObjectIterator endO() { return _value.Object->end(); }
-  ObjectItemType& frontO() { return _value.Object->front(); }
-  ObjectItemType& backO() { return _value.Object->back(); }
-  ArrayItemType& frontA() { return _value.Array->front(); }
-  ArrayItemType& backA() { return _value.Array->back(); }
+  ArrayIterator beginA() { return getArray().begin(); }
+  ObjectIterator beginO() {
+    lend();
+    return _value.Object->begin();
+  }
+  ArrayIterator endA() { return getArray().end(); }
+  ObjectIterator endO() {
+    lend();
+    return _value.Object->end();
+  }
+  ObjectItemType& frontO() {
+    lend();
+    return _value.Object->front();
+  }
+  ObjectItemType& backO() {
+    lend();
+    return _value.Object->back();
+  }
+  ArrayItemType& frontA() { return getArray().front(); }
+  ArrayItemType& backA() { return getArray().back(); }
 
   ArrayConstIterator beginA() const { return _value.Array->begin(); }
   ObjectConstIterator beginO() const { return _value.Object->begin(); }
@@ -660,41 +1057,314 @@ class YJson final {
   friend std::ostream& operator<<(std::ostream& out, const YJson& outJson);
 
  private:
+  // How a node holds its value. A String has an owned std::u8string on the
+  // heap, _size bytes borrowed from an in-situ buffer, or with Inline + n up
+  // to 14 bytes inline, from _text on over _size and _value. A Number is a
+  // double, or an integer: Int64 for anything that fits, UInt64 only above
+  // the int64_t range, so that each integer has one form. An Object is an
+  // IndexedObject once it is Indexed.
+  enum Storage : uint8_t { Default, Borrowed, Int64, UInt64, Indexed, Inline };
+  static constexpr size_t inlineCapacity = 14;
+
   YJson::Type _type;
+  Storage _storage = Default;
+  char8_t _text[2];
+  uint32_t _size = 0;
   union JsonValue {
-    void* Void;
-    double* Double = nullptr;
+    void* Void = nullptr;
+    double Double;
+    int64_t Int;
+    uint64_t UInt;
     std::u8string* String;
+    const char8_t* View;
     ObjectType* Object;
     ArrayType* Array;
   } _value;
 
+  template <std::integral _Ty>
+  void setInteger(_Ty val) {
+    if (std::cmp_less_equal(val, std::numeric_limits<int64_t>::max())) {
+      _storage = Int64;
+      _value.Int = static_cast<int64_t>(val);
+    } else {
+      _storage = UInt64;
+      _value.UInt = static_cast<uint64_t>(val);
+    }
+  }
+
+  double numberValue() const {
+    switch (_storage) {
+      case Int64: return static_cast<double>(_value.Int);
+      case UInt64: return static_cast<double>(_value.UInt);
+      default: return _value.Double;
+    }
+  }
+
+  // Integers are compared exactly, with each other and with doubles.
+  template <std::integral _Ty>
+  bool numberEquals(_Ty val) const {
+    switch (_storage) {
+      case Int64: return std::cmp_equal(_value.Int, val);
+      case UInt64: return std::cmp_equal(_value.UInt, val);
+      default: return fabs(static_cast<double>(val) - _value.Double) <=
+                      std::numeric_limits<double>::epsilon();
+    }
+  }
+  bool numberEquals(const YJson& other) const {
+    if (_storage == Default && other._storage == Default)
+      return _value.Double == other._value.Double;
+    if (_storage != Default && other._storage != Default)
+      return _storage == other._storage && _value.UInt == other._value.UInt;
+    const YJson& real = _storage == Default ? *this : other;
+    const YJson& integer = _storage == Default ? other : *this;
+    const double val = real._value.Double;
+    // Past 2^64 no double is an integer that fits.
+    if (val != std::trunc(val) || val < -0x1p63 || val >= 0x1p64)
+      return false;
+    return integer._storage == Int64 ? val < 0x1p63 && static_cast<int64_t>(val) == integer._value.Int
+                                     : val >= 0 && static_cast<uint64_t>(val) == integer._value.UInt;
+  }
+
+  // Objects with this many keys get a hash index.
+  static constexpr size_t indexThreshold = 32;
+  struct IndexedObject;
+
+  // Copies share containers, which count the nodes holding them; the first
+  // change through a node holding a shared one clones it (see detach()).
+  // Containers in a memory resource, or holding text borrowed from an
+  // in-situ buffer, are pinned and copied deep instead, so that copies own
+  // their text and live on the heap. So is a container that has lent out a
+  // mutable reference or iterator, but only by the next copy (see lend()).
+  struct Shared {
+    std::atomic<uint32_t> refs = 1;
+    bool pinned = false;
+    std::atomic<bool> lent = false;
+  };
+  template <typename _Container>
+  struct SharedContainer: _Container, Shared {
+    using _Container::_Container;
+  };
+  // IndexedObject is a SharedContainer<ObjectType> already.
+  template <typename _Container>
+  using Allocated = std::conditional_t<std::is_base_of_v<Shared, _Container>, _Container, SharedContainer<_Container>>;
+
+  // Containers are allocated from the resource of their own allocator.
+  template <typename _Container, typename... _Args>
+  static _Container* newContainer(std::pmr::memory_resource* resource, _Args&&... args) {
+    const auto container = std::pmr::polymorphic_allocator<>(resource).new_object<Allocated<_Container>>(
+        std::forward<_Args>(args)...);
+    container->pinned = resource != std::pmr::get_default_resource();
+    return container;
+  }
+  template <typename _Container>
+  static _Container* newContainer(_Container&& container) {
+    return newContainer<_Container>(container.get_allocator().resource(), std::move(container));
+  }
+  template <typename _Container>
+  static void deleteContainer(_Container* container) {
+    std::pmr::polymorphic_allocator<>(container->get_allocator().resource()).delete_object(
+        static_cast<Allocated<_Container>*>(container));
+  }
+  static Shared& shared(ArrayType* array) { return *static_cast<SharedContainer<ArrayType>*>(array); }
+  static Shared& shared(ObjectType* object) { return *static_cast<SharedContainer<ObjectType>*>(object); }
+  Shared& shared() const { return _type == Array ? shared(_value.Array) : shared(_value.Object); }
+  // Drops this node's hold on a container, which goes with the last one.
+  static bool release(Shared& shared) {
+    return shared.refs.load(std::memory_order_acquire) == 1 ||
+           shared.refs.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  }
+  // Takes a hold on the container of other, unless it is pinned or has lent
+  // out references since it was last copied.
+  bool share(const YJson& other) {
+    Shared& container = other.shared();
+    if (container.pinned)
+      return false;
+    if (container.lent.load(std::memory_order_relaxed) &&
+        container.lent.exchange(false, std::memory_order_relaxed))
+      return false;
+    container.refs.fetch_add(1, std::memory_order_relaxed);
+    _storage = other._storage;
+    _value = other._value;
+    return true;
+  }
+  // Called before a container is changed, and by lend(). A
+  // shared one is replaced by a clone of its own, whose elements are copies
+  // that share their containers in turn, so only the path down to the
+  // change is cloned. Readers of other copies, on any thread, are unaffected.
+  void detach() {
+    if ((_type == Array || _type == Object) && shared().refs.load(std::memory_order_acquire) > 1)
+      cloneContainer();
+  }
+  void cloneContainer();
+  // Called before a reference or iterator that may be used to change the
+  // container is handed out. The caller may still write through it after
+  // this node is copied, so the next copy is deep and leaves the references
+  // behind. Copies after that share again, and writes through references
+  // kept across more than one copy may reach the later ones.
+  void lend() {
+    detach();
+    shared().lent.store(true, std::memory_order_relaxed);
+  }
+
+  // Takes a new object, indexing it if it is big enough.
+  void setObject(ObjectType* object) {
+    _value.Object = object;
+    if (object->size() >= indexThreshold)
+      indexObject();
+  }
+  // Builds the index from scratch once the object is big enough.
+  void indexObject();
+  // Marks the index stale.
+  void dropIndex();
+  // Keep the index in step: after an item is inserted, before it is erased.
+  void indexItem(ObjectIterator item) {
+    if (_storage == Indexed || _value.Object->size() >= indexThreshold)
+      addToIndex(item);
+  }
+  void addToIndex(ObjectIterator item);
+  void unindexItem(ObjectIterator item);
+  ObjectIterator findIndexed(std::u8string_view key) const;
+  void deleteObject();
+
+  // The inline text starts at _text and runs on over _size and _value.
+  char8_t* inlineText() { return reinterpret_cast<char8_t*>(this) + offsetof(YJson, _text); }
+  const char8_t* inlineText() const { return const_cast<YJson*>(this)->inlineText(); }
+
+  // Sets the text of a String node that holds nothing yet.
+  void setString(std::u8string_view str) {
+    if (str.size() <= inlineCapacity) {
+      _storage = static_cast<Storage>(Inline + str.size());
+      std::copy(str.begin(), str.end(), inlineText());
+    } else {
+      _storage = Default;
+      _value.String = new std::u8string(str);
+    }
+  }
+  void setString(std::u8string&& str) {
+    if (str.size() <= inlineCapacity) {
+      setString(std::u8string_view(str));
+    } else {
+      _storage = Default;
+      _value.String = new std::u8string(std::move(str));
+    }
+  }
+
+  // Nodes do not know the resource they were built in, and so cannot give
+  // text back to it. Only an Arena, which drops everything at once, is given
+  // any; a KeyTable only lends keys.
+  static bool holdsText(std::pmr::memory_resource* resource);
+
+  // Copies a long string into resource and borrows it from there if that is
+  // an Arena, and owns it otherwise.
+  void setString(std::u8string_view str, std::pmr::memory_resource* resource) {
+    if (str.size() <= inlineCapacity || resource == std::pmr::get_default_resource() ||
+        str.size() > std::numeric_limits<uint32_t>::max() || !holdsText(resource)) {
+      setString(str);
+      return;
+    }
+    const auto data = static_cast<char8_t*>(resource->allocate(str.size(), 1));
+    std::memcpy(data, str.data(), str.size());
+    setBorrowed(std::u8string_view(data, str.size()));
+  }
+
+  void setBorrowed(std::u8string_view str) {
+    _type = YJson::String;
+    if (str.size() > std::numeric_limits<uint32_t>::max()) {
+      setString(str);
+      return;
+    }
+    _storage = Borrowed;
+    _size = static_cast<uint32_t>(str.size());
+    _value.View = str.data();
+  }
+
+  std::u8string_view stringView() const {
+    if (_storage >= Inline)
+      return std::u8string_view(inlineText(), _storage - Inline);
+    if (_storage == Borrowed)
+      return std::u8string_view(_value.View, _size);
+    return *_value.String;
+  }
+
+  // Mutable pointers only come from the in-situ constructors; every other
+  // contiguous range is parsed through const char8_t*.
+  template <typename _Iterator>
+  static constexpr bool isInSitu = std::is_same_v<_Iterator, char8_t*>;
+
+  // Contiguous byte ranges go through the two-stage parser in src/yjson.cpp,
+  // anything else is parsed char by char.
+  template <typename _Iterator>
+  void parseDocument(_Iterator first, _Iterator last) {
+    if constexpr (isByteRange<_Iterator>) {
+      const auto data = reinterpret_cast<const char8_t*>(std::to_address(first));
+      parseIndexed(data, data + (last - first));
+    } else {
+      parseValue(StrSkip(first, last), last);
+    }
+  }
+
+  class StructuralIndex;
+  void parseIndexed(const char8_t* first, const char8_t* last,
+                    std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+  struct LineChunk;
+  static void parseLineChunk(LineChunk& chunk);
+
+  struct ArrayRun;
+  static bool splitArray(const char8_t* first, const char8_t* last, size_t runSize,
+                         std::vector<ArrayRun>& runs);
+  static bool parseArrayRun(ArrayRun& run);
+  bool parseParallel(const char8_t* first, const char8_t* last, unsigned threads);
+
+  // Containers are allocated from resource, and long strings and keys go
+  // where setString() and Key put them.
   template <typename StrIterator>
-  StrIterator parseValue(StrIterator first, StrIterator last) {
+  StrIterator parseValue(StrIterator first, StrIterator last,
+                         std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
     StrIterator iter = first;
     if (last == first)
       goto empty;
 
     if (*first == '\"') {
-      std::u8string buffer;
-      iter = parseString(buffer, first, last);
-      _type = YJson::String;
-      _value.String = new std::u8string(std::move(buffer));
+      if constexpr (isInSitu<StrIterator>) {
+        std::u8string_view buffer;
+        iter = parseStringInSitu(buffer, first, last);
+        setBorrowed(buffer);
+      } else {
+        _type = YJson::String;
+        if constexpr (isByteRange<StrIterator>) {
+          // Strings without escapes go straight from the input to the resource.
+          const auto data = reinterpret_cast<const char8_t*>(std::to_address(first));
+          const auto end = resource != std::pmr::get_default_resource()
+                               ? plainString(data, data + (last - first)) : nullptr;
+          if (end) {
+            setString(std::u8string_view(data + 1, end), resource);
+            return first + (end - data + 1);
+          }
+        }
+        std::u8string buffer;
+        iter = parseString(buffer, first, last);
+        if (resource == std::pmr::get_default_resource())
+          setString(std::move(buffer));
+        else
+          setString(buffer, resource);
+      }
     } else if (*first == '-' || (*first >= '0' && *first <= '9')) {
-      double buffer;
-      iter = parseNumber(first, last, buffer);
-      _type = YJson::Number;
-      _value.Double = new double { buffer };
+      iter = parseNumberValue(first, last);
     } else if (*first == '[') {
-      ArrayType buffer;
+      ArrayType buffer(resource);
       iter = parseArray(first, last, buffer);
       _type = YJson::Array;
-      _value.Array = new ArrayType(std::move(buffer));
+      _value.Array = newContainer(std::move(buffer));
+      if constexpr (isInSitu<StrIterator>)
+        shared(_value.Array).pinned = true;
     } else if (*first == '{') {
-      ObjectType buffer;
+      ObjectType buffer(resource);
       iter = parseObject(first, last, buffer);
       _type = YJson::Object;
-      _value.Object = new ObjectType(std::move(buffer));
+      setObject(newContainer(std::move(buffer)));
+      if constexpr (isInSitu<StrIterator>)
+        shared(_value.Object).pinned = true;
     } else {
       iter += 4;
       if (iter > last) goto empty;
@@ -714,68 +1384,193 @@ empty:
     throw std::runtime_error("YJson Error: Parse empty data!");
   }
 
-  template <typename StrIterator>
-  static StrIterator parseNumber(StrIterator first, StrIterator last, double& buffer) {
-    buffer = 0;
-    int sign = 1;
-    int scale = 0;
-    int signsubscale = 1, subscale = 0;
+  // Length of the run of ASCII digits that starts the eight bytes at first,
+  // up to 8, with its value. Little-endian only.
+  static int parseEightDigits(const char8_t* first, uint32_t& value) {
+    uint64_t x;
+    std::memcpy(&x, first, sizeof x);
+    // Nonzero in each byte that is not a digit; a carry out of such a byte
+    // only disturbs the bytes after it.
+    const uint64_t other = ((x & 0xF0F0F0F0F0F0F0F0) ^ 0x3030303030303030) |
+                           (((x + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) ^ 0x3030303030303030);
+    const int count = std::countr_zero(other) / 8;
+    if (count == 0) {
+      value = 0;
+      return 0;
+    }
+    // Shifting the digits up leaves zero bytes in front, as leading zeros.
+    x = (x - 0x3030303030303030) << (64 - 8 * count);
+    x = (x * 10 + (x >> 8)) & 0x00FF00FF00FF00FF;
+    x = (x * 100 + (x >> 16)) & 0x0000FFFF0000FFFF;
+    value = static_cast<uint32_t>(x * 10000 + (x >> 32));
+    return count;
+  }
 
-    if (*first == '-') {
-      sign = -1;
-      if (++first == last) {
-        goto invalid;
+  // Reads a run of digits into mantissa, which keeps the first 19 significant
+  // ones; count is the number of significant digits seen so far.
+  template <typename StrIterator>
+  static StrIterator parseDigits(StrIterator first, StrIterator last, uint64_t& mantissa, int& count) {
+    if constexpr (isByteRange<StrIterator> && std::endian::native == std::endian::little) {
+      constexpr uint32_t scales[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+      while (count <= 11 && last - first >= 8) {
+        uint32_t value;
+        const int n = parseEightDigits(reinterpret_cast<const char8_t*>(std::to_address(first)), value);
+        mantissa = mantissa * scales[n] + value;
+        first += n;
+        count += n;
+        if (n != 8)
+          return first;
       }
     }
-    if (*first == '0') {
-      return ++first;
+    for (; first != last && *first >= '0' && *first <= '9'; ++first) {
+      if (mantissa == 0 && *first == '0')
+        continue;
+      if (count++ < 19)
+        mantissa = mantissa * 10 + (*first - '0');
     }
+    return first;
+  }
 
-    if (isdigit(*first)) {
-      do {
-        buffer *= 10;
-        buffer += *first - '0';
-      } while (++first != last && isdigit(*first));
-
-      if (first == last) {
-        return first;
-      }
+  // Integer literals that fit in 64 bits come out exact in integer, with
+  // storage set to Int64 or UInt64; anything else is a double in buffer and
+  // storage is Default. Numbers with at most 19 significant digits and a small
+  // exponent are exact in one multiplication or division; the rest go to
+  // std::from_chars.
+  template <typename StrIterator>
+  static StrIterator parseNumber(StrIterator first, StrIterator last, double& buffer,
+                                 Storage& storage, uint64_t& integer) {
+    constexpr double powersOf10[] = {
+      1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    const StrIterator start = first;
+    const bool negative = *first == '-';
+    bool integral = true;
+    uint64_t mantissa = 0;
+    int count = 0;
+    int64_t exponent = 0;
+    storage = Default;
+
+    if (negative && ++first == last) {
+      goto invalid;
+    }
+    if (*first == '0') {
+      ++first;
+    } else if (*first >= '1' && *first <= '9') {
+      first = parseDigits(first, last, mantissa, count);
+      exponent = std::max(count - 19, 0);
+    } else {
+      goto invalid;
     }
 
-    if (*first == '.') {
-      while (++first != last && isdigit(*first)) {
-        buffer *= 10.0;
-        buffer += *first - '0';
-        scale--;
-      }
-
-      if (first == last) {
-        goto result;
+    if (first != last && *first == '.') {
+      integral = false;
+      const int integerCount = count;
+      const StrIterator fraction = ++first;
+      first = parseDigits(first, last, mantissa, count);
+      if (first == fraction) {
+        goto invalid;
       }
+      // Only the digits past the 19th are dropped, all from the end.
+      const int dropped = std::max(count - 19, 0) - std::max(integerCount - 19, 0);
+      exponent -= (first - fraction) - dropped;
     }
 
-    if ('e' == *first || 'E' == *first) {
+    if (first != last && (*first == 'e' || *first == 'E')) {
+      integral = false;
       if (++first == last) {
         goto invalid;
       }
-      if (*first == '-') {
-        signsubscale = -1;
-        ++first;
-      } else if (*first == '+') {
-        ++first;
+      const bool negativeExponent = *first == '-';
+      if ((negativeExponent || *first == '+') && ++first == last) {
+        goto invalid;
+      }
+      if (*first < '0' || *first > '9') {
+        goto invalid;
       }
-      for (;first != last && isdigit(*first);++first) {
-        subscale *= 10;
-        subscale += *first - '0';
+      int64_t value = 0;
+      do {
+        if (value < 1000000)
+          value = value * 10 + (*first - '0');
+      } while (++first != last && *first >= '0' && *first <= '9');
+      exponent += negativeExponent ? -value : value;
+    }
+
+    // -0 stays a double to keep its sign. A 20th digit was not added to the
+    // mantissa yet.
+    if (integral && count <= 20 && !(negative && mantissa == 0)) {
+      const unsigned digit = *std::prev(first) - '0';
+      if (count < 20 || mantissa <= (std::numeric_limits<uint64_t>::max() - digit) / 10) {
+        if (count == 20)
+          mantissa = mantissa * 10 + digit;
+        if (!negative) {
+          storage = mantissa <= uint64_t(std::numeric_limits<int64_t>::max()) ? Int64 : UInt64;
+          integer = mantissa;
+          return first;
+        }
+        if (mantissa <= uint64_t(1) << 63) {
+          storage = Int64;
+          integer = 0 - mantissa;
+          return first;
+        }
       }
     }
-result:
-    buffer *= sign * pow(10, scale + signsubscale * subscale);
+
+    if (mantissa == 0) {
+      buffer = 0;
+    } else if (count <= 19 && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+      buffer = static_cast<double>(mantissa);
+      buffer = exponent < 0 ? buffer / powersOf10[-exponent] : buffer * powersOf10[exponent];
+    } else {
+      if constexpr (isByteRange<StrIterator>) {
+        const auto text = reinterpret_cast<const char*>(std::to_address(start));
+        buffer = parseDecimal(text + negative, text + (first - start), count + exponent);
+      } else {
+        const std::string text(std::next(start, negative), first);
+        buffer = parseDecimal(text.data(), text.data() + text.size(), count + exponent);
+      }
+    }
+    if (negative) {
+      buffer = -buffer;
+    }
     return first;
 invalid:
     throw std::runtime_error("YJson Error: Invalid Number.");
   }
 
+  // The same for callers that only take doubles.
+  template <typename StrIterator>
+  static StrIterator parseNumber(StrIterator first, StrIterator last, double& buffer) {
+    Storage storage;
+    uint64_t integer;
+    first = parseNumber(first, last, buffer, storage, integer);
+    if (storage == Int64) {
+      buffer = static_cast<double>(static_cast<int64_t>(integer));
+    } else if (storage == UInt64) {
+      buffer = static_cast<double>(integer);
+    }
+    return first;
+  }
+
+  // Parses the number at first into this node.
+  template <typename StrIterator>
+  StrIterator parseNumberValue(StrIterator first, StrIterator last) {
+    double buffer;
+    uint64_t integer;
+    first = parseNumber(first, last, buffer, _storage, integer);
+    _type = YJson::Number;
+    if (_storage == Default) {
+      _value.Double = buffer;
+    } else {
+      _value.UInt = integer;
+    }
+    return first;
+  }
+
+  // Correctly rounded value of the unsigned decimal [first, last), whose
+  // magnitude decides between infinity and zero when it is out of range.
+  static double parseDecimal(const char* first, const char* last, int64_t magnitude);
+
   template <typename T>
   static void parseHex4(T c, uint16_t& h) {
     if (c >= '0' && c <= '9')
@@ -798,104 +1593,340 @@ invalid:
     return h;
   }
 
+  // Length of the leading run that holds neither a quote nor a backslash.
+  static size_t plainRun(const char8_t* first, const char8_t* last) {
+    const char8_t* ptr = first;
+#ifdef YJSON_SSE2
+    const __m128i quote = _mm_set1_epi8('\"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    for (; last - ptr >= 16; ptr += 16) {
+      const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+      const unsigned mask = _mm_movemask_epi8(
+          _mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, backslash)));
+      if (mask)
+        return ptr - first + std::countr_zero(mask);
+    }
+#else
+    if constexpr (std::endian::native == std::endian::little) {
+      constexpr uint64_t ones = 0x0101010101010101, highs = 0x8080808080808080;
+      constexpr auto zeroByte = [](uint64_t x) { return (x - ones) & ~x & highs; };
+      for (; last - ptr >= 8; ptr += 8) {
+        uint64_t x;
+        std::memcpy(&x, ptr, 8);
+        // Only the lowest flagged byte is exact, which is the one we need.
+        const uint64_t mask = zeroByte(x ^ (ones * '\"')) | zeroByte(x ^ (ones * '\\'));
+        if (mask)
+          return ptr - first + (std::countr_zero(mask) >> 3);
+      }
+    }
+#endif
+    while (ptr != last && *ptr != '\"' && *ptr != '\\')
+      ++ptr;
+    return ptr - first;
+  }
+
+  // Decodes the escape whose backslash precedes ptr into out and returns its
+  // length. ptr is left on the last char of the escape.
+  template <typename StrIterator>
+  static size_t parseEscape(StrIterator& ptr, StrIterator last, char8_t* out) {
+    char8_t* bufferEnd;
+    size_t len;
+    char32_t uc, uc2;
+    switch (*ptr) {
+      case 'b':
+        *out = '\b';
+        return 1;
+      case 'f':
+        *out = '\f';
+        return 1;
+      case 'n':
+        *out = '\n';
+        return 1;
+      case 'r':
+        *out = '\r';
+        return 1;
+      case 't':
+        *out = '\t';
+        return 1;
+      case 'u': // like \uAABB
+        if (ptr + 5 > last) {
+          goto error_throw;
+        }
+        uc = parseHex4(ptr);
+
+        // Single wide character.
+
+        // Two wide characters.
+        if (uc >= utf16FirstWcharMark[0] && uc < utf16FirstWcharMark[1]) {
+          // Multipile wide characters.
+          if (++ptr + 6 > last) {
+            goto error_throw;
+          }
+          if (*ptr != '\\' || *++ptr != 'u')
+            throw std::runtime_error("YJson Error: Missing second-half of surrogate.");
+          uc2 = parseHex4(ptr);
+          if (uc2 >= utf16FirstWcharMark[1] && uc2 < utf16FirstWcharMark[2]) {
+            uc = 0x10000 + (((uc & 0x3FF) << 10) | (uc2 & 0x3FF));
+          } else {
+            throw std::runtime_error("YJson Error: Invalid second-half of surrogate.");
+          }
+        }
+
+        len = 4;
+        if (uc < 0x80)
+          len = 1;
+        else if (uc < 0x800)
+          len = 2;
+        else if (uc < 0x10000)
+          len = 3;
+        else if (uc > 0x10FFFF) {
+          throw std::runtime_error("YJson Error: Invalid Unicode.");
+        }
+        bufferEnd = out + len;
+
+        switch (len) {
+          case 4:
+            *--bufferEnd = ((uc | 0x80) & 0xBF);
+            uc >>= 6;
+            [[fallthrough]];
+          case 3:
+            *--bufferEnd = ((uc | 0x80) & 0xBF);
+            uc >>= 6;
+            [[fallthrough]];
+          case 2:
+            *--bufferEnd = ((uc | 0x80) & 0xBF);
+            uc >>= 6;
+            [[fallthrough]];
+          case 1:
+            *--bufferEnd = static_cast<uint8_t>(uc | utf8FirstCharMark[len]);
+        }
+        return len;
+error_throw:
+        throw std::runtime_error("YJson Error: Unicode chars are too short.");
+      default:
+        *out = *ptr;
+        return 1;
+    }
+  }
+
   template <typename StrIterator>
   static StrIterator parseString(std::u8string& des,
                                  StrIterator first,
                                  StrIterator last) {
-    char8_t bufferBegin[4], *bufferEnd;
-    size_t len;
+    char8_t buffer[4];
     des.clear();
     StrIterator ptr;
-    char32_t uc, uc2;
     for (ptr = first + 1; ptr != last && *ptr != '\"'; ++ptr) {
       if (*ptr != '\\') {
-        des.push_back(*ptr);
+        if constexpr (isByteRange<StrIterator>) {
+          const auto data = reinterpret_cast<const char8_t*>(std::to_address(ptr));
+          const size_t size = plainRun(data, data + (last - ptr));
+          des.append(data, size);
+          ptr += size - 1;
+        } else {
+          des.push_back(*ptr);
+        }
         continue;
       }
       if (++ptr == last) {
         throw std::runtime_error("YJson Error: String's length was too short to be parsed.");
       }
-      switch (*ptr) {
-        case 'b':
-          des.push_back('\b');
-          break;
-        case 'f':
-          des.push_back('\f');
-          break;
-        case 'n':
-          des.push_back('\n');
-          break;
-        case 'r':
-          des.push_back('\r');
+      des.append(buffer, parseEscape(ptr, last, buffer));
+    }
+    if (ptr == last || *ptr != '"') {
+      throw std::runtime_error("YJson Error: String missing right quotes.");
+    }
+    return ++ptr;
+  }
+
+  // parseString for in-situ buffers. Escapes are decoded in place, which never
+  // takes more room than the escape itself, and des views the result.
+  static char8_t* parseStringInSitu(std::u8string_view& des,
+                                    char8_t* first,
+                                    char8_t* last) {
+    char8_t buffer[4];
+    char8_t* const begin = first + 1;
+    char8_t* ptr = begin;
+    char8_t* out = begin;
+    for (;;) {
+      const size_t size = plainRun(ptr, last);
+      if (out != ptr)
+        std::memmove(out, ptr, size);
+      out += size;
+      ptr += size;
+      if (ptr == last || *ptr == '\"')
+        break;
+      if (++ptr == last) {
+        throw std::runtime_error("YJson Error: String's length was too short to be parsed.");
+      }
+      const size_t len = parseEscape(ptr, last, buffer);
+      std::memcpy(out, buffer, len);
+      out += len;
+      ++ptr;
+    }
+    if (ptr == last) {
+      throw std::runtime_error("YJson Error: String missing right quotes.");
+    }
+    des = std::u8string_view(begin, out);
+    return ++ptr;
+  }
+
+  template <typename StrIterator>
+  static StrIterator parseKey(Key& des, StrIterator first, StrIterator last,
+                              std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    if constexpr (isInSitu<StrIterator>) {
+      std::u8string_view view;
+      first = parseStringInSitu(view, first, last);
+      des = Key::borrow(view);
+      return first;
+    } else {
+      if constexpr (isByteRange<StrIterator>) {
+        // Most keys have no escapes and are copied straight from the input.
+        const auto data = reinterpret_cast<const char8_t*>(std::to_address(first));
+        if (const auto end = plainString(data, data + (last - first))) {
+          des = Key(std::u8string_view(data + 1, end), *resource);
+          return first + (end - data + 1);
+        }
+      }
+      std::u8string buffer;
+      first = parseString(buffer, first, last);
+      des = Key(buffer, *resource);
+      return first;
+    }
+  }
+
+  // The closing quote of the string at first if it has no escapes, else null.
+  static const char8_t* plainString(const char8_t* first, const char8_t* last) {
+    ++first;
+    const char8_t* end = first + plainRun(first, last);
+    return end != last && *end == '\"' ? end : nullptr;
+  }
+
+  template <typename StrIterator>
+  static std::u8string_view saxString(StrIterator& first, StrIterator last, std::u8string& buffer) {
+    if constexpr (isByteRange<StrIterator>) {
+      const auto data = reinterpret_cast<const char8_t*>(std::to_address(first));
+      if (const auto end = plainString(data, data + (last - first))) {
+        first += end - data + 1;
+        return std::u8string_view(data + 1, end);
+      }
+    }
+    first = parseString(buffer, first, last);
+    return buffer;
+  }
+
+  template <typename Handler, typename StrIterator>
+  static bool saxValue(Handler& handler, StrIterator& first, StrIterator last,
+                       std::u8string& buffer) {
+    if (first == last)
+      goto empty;
+    if (*first == '\"') {
+      return handler.onString(saxString(first, last, buffer));
+    } else if (*first == '-' || (*first >= '0' && *first <= '9')) {
+      double value;
+      if constexpr (requires { handler.onInteger(int64_t()); handler.onUnsigned(uint64_t()); }) {
+        Storage storage;
+        uint64_t integer;
+        first = parseNumber(first, last, value, storage, integer);
+        if (storage == Int64)
+          return handler.onInteger(static_cast<int64_t>(integer));
+        if (storage == UInt64)
+          return handler.onUnsigned(integer);
+      } else {
+        first = parseNumber(first, last, value);
+      }
+      return handler.onNumber(value);
+    } else if (*first == '[') {
+      return saxArray(handler, first, last, buffer);
+    } else if (*first == '{') {
+      return saxObject(handler, first, last, buffer);
+    } else if (last - first >= 4 && std::equal(first, first + 4, "null")) {
+      first += 4;
+      return handler.onNull();
+    } else if (last - first >= 4 && std::equal(first, first + 4, "true")) {
+      first += 4;
+      return handler.onBool(true);
+    } else if (last - first >= 5 && std::equal(first, first + 5, "false")) {
+      first += 5;
+      return handler.onBool(false);
+    }
+empty:
+    throw std::runtime_error("YJson Error: Parse empty data!");
+  }
+
+  template <typename Handler, typename StrIterator>
+  static bool saxArray(Handler& handler, StrIterator& first, StrIterator last,
+                       std::u8string& buffer) {
+    if (!handler.onStartArray())
+      return false;
+    first = StrSkip(++first, last);
+    if (first == last) {
+      goto missing;
+    }
+    if (*first != ']') {
+      for (;;) {
+        if (!saxValue(handler, first, last, buffer))
+          return false;
+        first = StrSkip(first, last);
+        if (first == last || *first != ',')
           break;
-        case 't':
-          des.push_back('\t');
+        first = StrSkip(++first, last);
+        if (first == last || *first == ']')
           break;
-        case 'u': // like \uAABB
-          if (ptr + 5 > last) {
-            goto error_throw;
-          }
-          uc = parseHex4(ptr);
-
-          // Single wide character.
-
-          // Two wide characters.
-          if (uc >= utf16FirstWcharMark[0] && uc < utf16FirstWcharMark[1]) {
-            // Multipile wide characters.
-            if (++ptr + 6 > last) {
-              goto error_throw;
-            }
-            if (*ptr != '\\' || *++ptr != 'u')
-              throw std::runtime_error("YJson Error: Missing second-half of surrogate.");
-            uc2 = parseHex4(ptr);
-            if (uc2 >= utf16FirstWcharMark[1] && uc2 < utf16FirstWcharMark[2]) {
-              uc = 0x10000 + (((uc & 0x3FF) << 10) | (uc2 & 0x3FF));
-            } else {
-              throw std::runtime_error("YJson Error: Invalid second-half of surrogate.");
-            }
-          }
+      }
+      if (first == last || *first != ']') {
+        goto missing;
+      }
+    }
+    ++first;
+    return handler.onEndArray();
+missing:
+    throw std::runtime_error("YJson Error: Array missing right square brackets.");
+  }
 
-          len = 4;
-          if (uc < 0x80)
-            len = 1;
-          else if (uc < 0x800)
-            len = 2;
-          else if (uc < 0x10000)
-            len = 3;
-          else if (uc > 0x10FFFF) {
-            throw std::runtime_error("YJson Error: Invalid Unicode.");
-          }
-          bufferEnd = bufferBegin + len;
-
-          switch (len) {
-            case 4:
-              *--bufferEnd = ((uc | 0x80) & 0xBF);
-              uc >>= 6;
-              [[fallthrough]];
-            case 3:
-              *--bufferEnd = ((uc | 0x80) & 0xBF);
-              uc >>= 6;
-              [[fallthrough]];
-            case 2:
-              *--bufferEnd = ((uc | 0x80) & 0xBF);
-              uc >>= 6;
-              [[fallthrough]];
-            case 1:
-              *--bufferEnd = static_cast<uint8_t>(uc | utf8FirstCharMark[len]);
-          }
-          des.append(bufferBegin, bufferBegin + len);
+  template <typename Handler, typename StrIterator>
+  static bool saxObject(Handler& handler, StrIterator& first, StrIterator last,
+                        std::u8string& buffer) {
+    if (!handler.onStartObject())
+      return false;
+    first = StrSkip(++first, last);
+    if (first == last) {
+      goto missing;
+    }
+    if (*first != '}') {
+      for (;;) {
+        if (*first != '\"') {
+          goto invalid;
+        }
+        if (!handler.onKey(saxString(first, last, buffer)))
+          return false;
+        first = StrSkip(first, last);
+        if (first == last) {
+          goto missing;
+        }
+        if (*first != ':') {
+          goto invalid;
+        }
+        first = StrSkip(++first, last);
+        if (!saxValue(handler, first, last, buffer))
+          return false;
+        first = StrSkip(first, last);
+        if (first == last || *first != ',')
           break;
-error_throw:
-          throw std::runtime_error("YJson Error: Unicode chars are too short.");
-        default:
-          des.push_back(*ptr);
+        first = StrSkip(++first, last);
+        if (first == last || *first == '}')
           break;
       }
+      if (first == last || *first != '}') {
+        goto missing;
+      }
     }
-    if (ptr == last || *ptr != '"') {
-      throw std::runtime_error("YJson Error: String missing right quotes.");
-    }
-    return ++ptr;
+    ++first;
+    return handler.onEndObject();
+missing:
+    throw std::runtime_error("YJson Error: Object missing right brace.");
+invalid:
+    throw std::runtime_error("YJson Error: Invalid Object.");
   }
 
   template <typename StrIterator>
@@ -909,7 +1940,7 @@ error_throw:
     }
 
     buffer.emplace_back();
-    first = StrSkip(buffer.back().parseValue(first, last), last);
+    first = StrSkip(buffer.back().parseValue(first, last, buffer.get_allocator().resource()), last);
     if (first == last)
       goto missing;
 
@@ -922,7 +1953,7 @@ error_throw:
         return ++iter;
       }
       buffer.emplace_back();
-      first = StrSkip(buffer.back().parseValue(iter, last), last);
+      first = StrSkip(buffer.back().parseValue(iter, last, buffer.get_allocator().resource()), last);
       if (first == last) {
         goto missing;
       }
@@ -946,7 +1977,7 @@ missing:
     }
 
     buffer.emplace_back();
-    first = StrSkip(parseString(buffer.back().first, first, last), last);
+    first = StrSkip(parseKey(buffer.back().first, first, last, buffer.get_allocator().resource()), last);
 
     if (first == last) {
       goto missing;
@@ -956,7 +1987,7 @@ missing:
     }
 
     first = StrSkip(++first, last);
-    first = StrSkip(buffer.back().second.parseValue(first, last), last);
+    first = StrSkip(buffer.back().second.parseValue(first, last, buffer.get_allocator().resource()), last);
 
     if (first == last) {
       goto missing;
@@ -972,12 +2003,13 @@ missing:
         return ++iter;
       }
       buffer.emplace_back();
-      first = StrSkip(parseString(buffer.back().first, iter, last), last);
+      first = StrSkip(parseKey(buffer.back().first, iter, last, buffer.get_allocator().resource()), last);
 
       if (*first != ':') {
         goto invalid;
       }
-      first = StrSkip(buffer.back().second.parseValue(StrSkip(++first, last), last), last);
+      first = StrSkip(buffer.back().second.parseValue(StrSkip(++first, last), last,
+                                                      buffer.get_allocator().resource()), last);
       if (first == last) {
         goto missing;
       }
@@ -992,8 +2024,10 @@ invalid:
     throw std::runtime_error("YJson Error: Invalid Object.");
   }
 
-  template <typename _Ty>
-  void printValue(_Ty& pre) const {
+  // One printer for every layout; the members of _Policy are constants, so
+  // what it leaves off costs nothing.
+  template <typename _Policy, typename _Ty>
+  void printValue(_Ty& pre, int depth) const {
     switch (_type) {
       case YJson::Null:
         pre.write("null", 4);
@@ -1005,50 +2039,849 @@ invalid:
         pre.write("true", 4);
         break;
       case YJson::Number:
-        printNumber(pre);
+        printNumber<_Policy>(pre);
         break;
       case YJson::String:
-        printString(pre, *_value.String);
+        printString<_Policy::ascii>(pre, stringView());
         break;
       case YJson::Array:
-        printArray(pre);
+        printArray<_Policy>(pre, depth);
         break;
       case YJson::Object:
-        return printObject(pre);
+        printObject<_Policy>(pre, depth);
+        break;
       default:
-        throw std::runtime_error("YJson Error: Unknown type to print.");
-        return;
+        throw std::runtime_error("YJson Error: Unknown yjson type.");
     }
   }
-  void printValue(std::ostream& pre, int depth) const;
-  void printNumber(std::ostream& pre) const {
-    pre << std::format("{}", *_value.Double);
+  // Doubles come out in the shortest form that reads back the same, as
+  // std::to_chars writes them, unless the policy sets a precision. Whole
+  // numbers without trailing zeros print the same as integers, which is
+  // quicker; the rest may be shorter in exponent form, like 1e+06.
+  template <typename _Policy = Compact, typename _Ty>
+  void printNumber(_Ty& pre) const {
+    char buffer[32];
+    std::to_chars_result result;
+    if (_storage == Int64) {
+      result = std::to_chars(buffer, buffer + sizeof buffer, _value.Int);
+    } else if (_storage == UInt64) {
+      result = std::to_chars(buffer, buffer + sizeof buffer, _value.UInt);
+    } else if constexpr (_Policy::precision > 0) {
+      result = std::to_chars(buffer, buffer + sizeof buffer, _value.Double,
+                             std::chars_format::general, _Policy::precision);
+    } else if (const double val = _value.Double; std::fabs(val) < 0x1p53 &&
+               static_cast<double>(static_cast<int64_t>(val)) == val &&
+               static_cast<int64_t>(val) % 10 != 0) {
+      result = std::to_chars(buffer, buffer + sizeof buffer, static_cast<int64_t>(val));
+    } else {
+      result = std::to_chars(buffer, buffer + sizeof buffer, val);
+    }
+    pre.write(buffer, result.ptr - buffer);
+  }
+  // What follows the backslash for each ASCII char that must be escaped;
+  // 'u' stands for a \u00XX escape and 0 for no escape at all.
+  static constexpr auto escapeTable = [] {
+    std::array<char, 128> table {};
+    for (int i = 0; i != 32; ++i)
+      table[i] = 'u';
+    table['\b'] = 'b';
+    table['\f'] = 'f';
+    table['\n'] = 'n';
+    table['\r'] = 'r';
+    table['\t'] = 't';
+    table['\"'] = '\"';
+    table['\\'] = '\\';
+    return table;
+  }();
+
+  // Length of the leading run printString can copy as it is. With _Ascii,
+  // non-ASCII bytes end the run too.
+  template <bool _Ascii>
+  static size_t cleanRun(const char8_t* first, const char8_t* last) {
+    const char8_t* ptr = first;
+#ifdef YJSON_SSE2
+    const __m128i quote = _mm_set1_epi8('\"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(31);
+    for (; last - ptr >= 16; ptr += 16) {
+      const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+      unsigned mask = _mm_movemask_epi8(
+          _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, backslash)),
+                       _mm_cmpeq_epi8(_mm_min_epu8(x, control), x)));
+      if constexpr (_Ascii)
+        mask |= _mm_movemask_epi8(x);
+      if (mask)
+        return ptr - first + std::countr_zero(mask);
+    }
+#else
+    if constexpr (std::endian::native == std::endian::little) {
+      constexpr uint64_t ones = 0x0101010101010101, highs = 0x8080808080808080;
+      constexpr auto zeroByte = [](uint64_t x) { return (x - ones) & ~x & highs; };
+      for (; last - ptr >= 8; ptr += 8) {
+        uint64_t x;
+        std::memcpy(&x, ptr, 8);
+        // As in plainRun, only the lowest flagged byte is exact.
+        uint64_t mask = zeroByte(x ^ (ones * '\"')) | zeroByte(x ^ (ones * '\\')) |
+                        ((x - ones * 32) & ~x & highs);
+        if constexpr (_Ascii)
+          mask |= x & highs;
+        if (mask)
+          return ptr - first + (std::countr_zero(mask) >> 3);
+      }
+    }
+#endif
+    while (ptr != last && (*ptr >= 0x80 ? !_Ascii : !escapeTable[*ptr]))
+      ++ptr;
+    return ptr - first;
+  }
+
+  template <typename _Ty>
+  static void printUnicodeEscape(_Ty& pre, char32_t code) {
+    constexpr char digits[] = "0123456789abcdef";
+    const char escape[] = {'\\', 'u', digits[code >> 12 & 15], digits[code >> 8 & 15],
+                           digits[code >> 4 & 15], digits[code & 15]};
+    pre.write(escape, sizeof escape);
+  }
+
+  // Prints the UTF-8 sequence at first as \u escapes, a surrogate pair above
+  // U+FFFF, and returns where the next one starts. Each malformed byte comes
+  // out as U+FFFD.
+  template <typename _Ty>
+  static const char8_t* printUtf8Escape(_Ty& pre, const char8_t* first, const char8_t* last) {
+    constexpr char32_t least[] = {0, 0, 0x80, 0x800, 0x10000};
+    const char8_t lead = *first;
+    const int length = lead >= 0xF8 ? 0 : lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 0;
+    char32_t code = 0xFFFD;
+    if (length && last - first >= length) {
+      char32_t value = lead & (0x7F >> length);
+      int i = 1;
+      for (; i != length && (first[i] & 0xC0) == 0x80; ++i)
+        value = value << 6 | (first[i] & 0x3F);
+      if (i == length && value >= least[length] && value <= 0x10FFFF) {
+        code = value;
+        first += length - 1;
+      }
+    }
+    if (code > 0xFFFF) {
+      code -= 0x10000;
+      printUnicodeEscape(pre, 0xD800 | code >> 10);
+      printUnicodeEscape(pre, 0xDC00 | (code & 0x3FF));
+    } else {
+      printUnicodeEscape(pre, code);
+    }
+    return first + 1;
+  }
+
+  // Copies clean runs whole and escapes the bytes between them; with _Ascii
+  // everything past U+007F is escaped as well.
+  template <bool _Ascii = false, typename _Ty>
+  static void printString(_Ty& pre, const std::u8string_view str) {
+    const char8_t* first = str.data();
+    const char8_t* const last = first + str.size();
+    pre.put('\"');
+    for (;;) {
+      const size_t run = cleanRun<_Ascii>(first, last);
+      pre.write(reinterpret_cast<const char*>(first), run);
+      if ((first += run) == last)
+        break;
+      if (*first >= 0x80) {
+        if constexpr (_Ascii)
+          first = printUtf8Escape(pre, first, last);
+      } else if (const char escape = escapeTable[*first]; escape == 'u') {
+        printUnicodeEscape(pre, *first++);
+      } else {
+        const char text[] = {'\\', escape};
+        pre.write(text, sizeof text);
+        ++first;
+      }
+    }
+    pre.put('\"');
+  }
+  // A comma, the policy's newline and a run of its indent char, so that
+  // what goes between two elements is usually one write. The run is kept
+  // short: with a longer one GCC copies it with rep movsb, which is slow
+  // for the few bytes usually taken.
+  template <typename _Policy>
+  static constexpr auto lineBuffer = [] {
+    std::array<char, 1 + _Policy::newline.size() + 32> buffer {','};
+    std::fill(std::copy(_Policy::newline.begin(), _Policy::newline.end(), buffer.begin() + 1),
+              buffer.end(), _Policy::indentChar);
+    return buffer;
+  }();
+  // Writes the comma before an element unless it is the first and, when the
+  // policy indents, a line break indented to depth.
+  template <typename _Policy, typename _Ty>
+  static void printSeparator(_Ty& pre, int depth, bool comma) {
+    if constexpr (_Policy::indent == 0) {
+      if (comma)
+        pre.put(',');
+    } else {
+      constexpr auto& line = lineBuffer<_Policy>;
+      constexpr size_t head = 1 + _Policy::newline.size(), run = line.size() - head;
+      const size_t size = static_cast<size_t>(depth) * _Policy::indent;
+      const char* const first = line.data() + !comma;
+      if (size <= run) {
+        pre.write(first, line.data() + head + size - first);
+      } else {
+        pre.write(first, line.data() + line.size() - first);
+        printIndent<_Policy>(pre, size - run);
+      }
+    }
+  }
+  template <typename _Policy, typename _Ty>
+  static void printIndent(_Ty& pre, size_t size) {
+    constexpr auto& line = lineBuffer<_Policy>;
+    constexpr size_t head = 1 + _Policy::newline.size(), run = line.size() - head;
+    for (; size; size -= std::min(size, run))
+      pre.write(line.data() + head, std::min(size, run));
+  }
+  template <typename _Policy, typename _Ty>
+  void printArray(_Ty& pre, int depth) const {
+    if (_value.Array->empty()) {
+      pre.write("[]", 2);
+      return;
+    }
+    ++depth;
+    pre.put('[');
+    auto i = _value.Array->begin(), j = _value.Array->end();
+    printSeparator<_Policy>(pre, depth, false);
+    i->printValue<_Policy>(pre, depth);
+    for (++i; i != j; ++i) {
+      printSeparator<_Policy>(pre, depth, true);
+      i->printValue<_Policy>(pre, depth);
+    }
+    printSeparator<_Policy>(pre, depth - 1, false);
+    pre.put(']');
+  }
+  template <typename _Policy, typename _Ty>
+  static void printMember(_Ty& pre, const ObjectType::value_type& member, int depth) {
+    printString<_Policy::ascii>(pre, member.first);
+    if constexpr (_Policy::indent > 0) {
+      pre.write(": ", 2);
+    } else {
+      pre.put(':');
+    }
+    member.second.printValue<_Policy>(pre, depth);
+  }
+  // Sorted keys compare bytewise, and equal keys keep their order.
+  template <typename _Policy, typename _Ty>
+  void printObject(_Ty& pre, int depth) const {
+    if (_value.Object->empty()) {
+      pre.write("{}", 2);
+      return;
+    }
+    ++depth;
+    pre.put('{');
+    if constexpr (_Policy::sortKeys) {
+      std::array<std::byte, 512> stack;
+      std::pmr::monotonic_buffer_resource resource(stack.data(), stack.size());
+      std::pmr::vector<const ObjectType::value_type*> members(&resource);
+      members.reserve(_value.Object->size());
+      for (const auto& member : *_value.Object)
+        members.push_back(&member);
+      std::stable_sort(members.begin(), members.end(), [](auto a, auto b) {
+        return std::u8string_view(a->first) < std::u8string_view(b->first);
+      });
+      for (size_t i = 0; i != members.size(); ++i) {
+        printSeparator<_Policy>(pre, depth, i != 0);
+        printMember<_Policy>(pre, *members[i], depth);
+      }
+    } else {
+      auto i = _value.Object->begin(), j = _value.Object->end();
+      printSeparator<_Policy>(pre, depth, false);
+      printMember<_Policy>(pre, *i, depth);
+      for (++i; i != j; ++i) {
+        printSeparator<_Policy>(pre, depth, true);
+        printMember<_Policy>(pre, *i, depth);
+      }
+    }
+    printSeparator<_Policy>(pre, depth - 1, false);
+    pre.put('}');
   }
-  static void printString(std::ostream& pre, const std::u8string_view str);
-  void printArray(std::ostream& pre) const;
-  void printArray(std::ostream& pre, int depth) const;
-  void printObject(std::ostream& pre) const;
-  void printObject(std::ostream& pre, int depth) const;
 
   void clearData() {
     switch (_type) {
       case YJson::Object:
-        delete _value.Object;
+        deleteObject();
         break;
       case YJson::Array:
-        delete _value.Array;
-        break;
-      case YJson::Number:
-        delete _value.Double;
+        if (release(shared(_value.Array)))
+          deleteContainer(_value.Array);
         break;
       case YJson::String:
-        delete _value.String;
+        if (_storage == Default)
+          delete _value.String;
         break;
       default:
         break;
     }
+    _storage = Default;
+  }
+};
+
+static_assert(sizeof(YJson) == 16, "inline text relies on a 16-byte node");
+
+// A bump allocator for trees that are built, read and dropped together.
+// Deallocation only counts the bytes as wasted; reset() rewinds over the
+// blocks already held, so a reused arena stops allocating once it has
+// grown to fit, and release() gives them back.
+class YJson::Arena: public std::pmr::memory_resource {
+ public:
+  explicit Arena(size_t blockSize = 64 << 10) : _blockSize(blockSize) {}
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  ~Arena() { release(); }
+
+  // Every tree built in the arena must be gone first.
+  void reset();
+  void release();
+
+  // Bytes handed out since the last reset, and how many of them, along with
+  // alignment padding and the unused ends of blocks, are of no more use.
+  size_t bytesUsed() const { return _used; }
+  size_t bytesWasted() const { return _wasted; }
+  // Bytes held in blocks.
+  size_t capacity() const { return _capacity; }
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void*, size_t bytes, size_t) override { _wasted += bytes; }
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  struct Block {
+    char* data;
+    size_t size;
+  };
+
+  size_t _blockSize;
+  std::vector<Block> _blocks;
+  // The block being filled, and the free part of it.
+  size_t _current = 0;
+  char* _first = nullptr;
+  char* _last = nullptr;
+  size_t _used = 0;
+  size_t _wasted = 0;
+  size_t _capacity = 0;
+};
+
+// Keeps one copy of each long object key. A tree built in the table, with
+// YJson(&table, first, last), takes its containers from the upstream
+// resource and borrows every key too long to be inline from the table, so
+// repeated keys share their bytes and the table must outlive the tree.
+// Keys are only dropped with the table. Strings are owned by their nodes.
+class YJson::KeyTable: public std::pmr::memory_resource {
+ public:
+  explicit KeyTable(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+    : _upstream(upstream) {}
+  KeyTable(const KeyTable&) = delete;
+  KeyTable& operator=(const KeyTable&) = delete;
+
+  // The table's copy of key, added if it is new. Passing it to find()
+  // matches keys from the table by address.
+  std::u8string_view intern(std::u8string_view key);
+  size_t size() const { return _keys.size(); }
+  // Bytes held for the keys.
+  size_t bytesUsed() const { return _bytes.bytesUsed(); }
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    return _upstream->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* data, size_t bytes, size_t alignment) override {
+    _upstream->deallocate(data, bytes, alignment);
   }
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  std::pmr::memory_resource* _upstream;
+  Arena _bytes {4096};
+  std::unordered_set<std::u8string_view> _keys;
 };
 
+// A tree parsed in situ together with the buffer it borrows from and an arena
+// for its containers, so values moved out of it must not outlive it.
+class YJson::Document {
+ public:
+  explicit Document(std::u8string json)
+    : _buffer(std::make_unique<std::u8string>(std::move(json))),
+      _arena(std::make_unique<Arena>(std::max<size_t>(_buffer->size(), 4096))),
+      _root(YJson::inSitu, *_buffer, _arena.get()) {}
+
+  // Parses json in place of the current tree, reusing the buffer and the
+  // arena, so that once they have grown to fit the messages it is given it
+  // parses without allocating. The old tree goes first; on error the root
+  // is left null.
+  void reparse(std::u8string_view json) {
+    _root = YJson();
+    _arena->reset();
+    _buffer->assign(json);
+    _root = YJson(YJson::inSitu, *_buffer, _arena.get());
+  }
+
+  const Arena& arena() const { return *_arena; }
+
+  YJson& root() { return _root; }
+  const YJson& root() const { return _root; }
+  YJson& operator*() { return _root; }
+  const YJson& operator*() const { return _root; }
+  YJson* operator->() { return &_root; }
+  const YJson* operator->() const { return &_root; }
+
+ private:
+  // Held by pointer so that moving the document keeps every view valid.
+  std::unique_ptr<std::u8string> _buffer;
+  std::unique_ptr<Arena> _arena;
+  YJson _root;
+};
+
+// Parses input that arrives in pieces, such as messages read from a socket.
+// Nesting is tracked on an explicit stack, and strings, numbers and literals
+// split across chunks are buffered until they end, so a chunk may stop
+// anywhere, even inside a unicode escape. Complete tokens go through the same
+// parseValue and parseKey as the DOM parser. After an error, call reset()
+// before feeding the next message.
+class YJson::PushParser {
+ public:
+  PushParser() = default;
+  // The stack points into the parser itself.
+  PushParser(const PushParser&) = delete;
+  PushParser& operator=(const PushParser&) = delete;
+
+  void feed(const char8_t* data, size_t size);
+  void feed(std::u8string_view data) { feed(data.data(), data.size()); }
+
+  // True once the top-level value has ended. A top-level number or literal
+  // only ends at finish(), since more digits could still arrive.
+  bool done() const { return _state == Complete; }
+
+  // Hands over the parsed value and resets the parser for the next message.
+  YJson finish();
+  void reset();
+
+ private:
+  enum State : uint8_t {
+    ExpectValue,
+    ExpectValueOrEnd,
+    ExpectKey,
+    ExpectKeyOrEnd,
+    ExpectColon,
+    ExpectCommaOrEnd,
+    Complete
+  };
+  enum Token : uint8_t { NoToken, StringToken, ScalarToken };
+
+  const char8_t* scanString(const char8_t* first, const char8_t* last);
+  static const char8_t* scanScalar(const char8_t* first, const char8_t* last);
+  void endToken(const char8_t* first, const char8_t* last);
+  YJson& nextValue();
+  void open(YJson::Type type);
+  void close(char8_t c);
+  void endValue() { _state = _stack.empty() ? Complete : ExpectCommaOrEnd; }
+
+  YJson _root;
+  std::vector<YJson*> _stack;
+  std::u8string _buffer;
+  State _state = ExpectValue;
+  Token _token = NoToken;
+  bool _escaped = false;
+};
+
+// A document that is only parsed where it is read. Members and elements are
+// found by skipping their siblings with bracket matching, without checking
+// them, and each value is parsed on the first call to value(). Everything
+// found is cached. The text must outlive the document.
+class YJson::Lazy {
+ public:
+  Lazy(const char8_t* first, const char8_t* last);
+  explicit Lazy(std::u8string_view json) : Lazy(json.data(), json.data() + json.size()) {}
+
+  YJson::Type type() const;
+  std::u8string_view text() const { return std::u8string_view(_first, _last); }
+
+  // Null if the object has no such key.
+  Lazy* find(std::u8string_view key);
+  Lazy& operator[](std::u8string_view key);
+  Lazy& operator[](const char8_t* key) { return operator[](std::u8string_view(key)); }
+  Lazy& operator[](size_t index);
+  size_t size();
+
+  // This value as a normal YJson, parsed on first use.
+  const YJson& value();
+
+ private:
+  struct Member;
+
+  bool scanNext();
+  static const char8_t* skipValue(const char8_t* first, const char8_t* last);
+  static const char8_t* skipString(const char8_t* first, const char8_t* last);
+
+  const char8_t* _first;
+  const char8_t* _last;
+  // Where the next unscanned member starts, or null once all are known.
+  const char8_t* _scan = nullptr;
+  std::vector<std::unique_ptr<Member>> _members;
+  std::unique_ptr<YJson> _value;
+};
+
+struct YJson::Lazy::Member {
+  YJson::Key key;
+  YJson::Lazy value;
+};
+
+
+// A read-only document kept as one tape of 64-bit words and one buffer of
+// string bytes, so it takes two allocations and is scanned front to back.
+// Each word has a tag in its top byte. Numbers and strings take a second
+// word, with the bits of the number or the length of the string, and the
+// first word of a string holds its offset in the buffer. An array or object
+// is an opening word holding the index just past its closing word, so a
+// sibling is one jump away, then its children, with each member as a key
+// followed by its value, then a closing word holding the count of children.
+class YJson::Tape {
+ public:
+  class Iterator;
+
+  // A position on the tape, which must outlive it.
+  class Value {
+   public:
+    YJson::Type type() const;
+    bool isArray() const { return type() == YJson::Array; }
+    bool isObject() const { return type() == YJson::Object; }
+    bool isString() const { return type() == YJson::String; }
+    bool isNumber() const { return type() == YJson::Number; }
+    bool isNull() const { return type() == YJson::Null; }
+
+    std::u8string_view getValueString() const { return _tape->string(_index); }
+    template<typename _Ty=int32_t>
+    _Ty getValueInt() const {
+      const uint64_t bits = _tape->_words[_index + 1];
+      switch (_tape->tag(_index)) {
+        case Int64: return static_cast<_Ty>(static_cast<int64_t>(bits));
+        case UInt64: return static_cast<_Ty>(bits);
+        default: return static_cast<_Ty>(std::bit_cast<double>(bits));
+      }
+    }
+    double getValueDouble() const;
+
+    // Elements of an array or members of an object; the count is read
+    // from the closing word.
+    size_t size() const;
+    Iterator begin() const;
+    Iterator end() const;
+    // Members are searched in order, and the first with the key is found.
+    std::optional<Value> find(std::u8string_view key) const;
+    Value operator[](std::u8string_view key) const;
+    Value operator[](const char8_t* key) const { return operator[](std::u8string_view(key)); }
+    Value operator[](size_t index) const;
+
+    YJson toYJson() const { return _tape->toYJson(_index); }
+    std::u8string toString(bool fmt = false) const;
+
+   private:
+    friend class Tape;
+    Value(const Tape* tape, size_t index): _tape(tape), _index(index) {}
+
+    const Tape* _tape;
+    size_t _index;
+  };
+
+  // Walks the children of an array or object; key() is the key of the
+  // current member.
+  class Iterator {
+   public:
+    Value operator*() const { return Value(_tape, _index + (_object ? 2 : 0)); }
+    std::u8string_view key() const { return _tape->string(_index); }
+    Iterator& operator++() {
+      _index = _tape->next(_index + (_object ? 2 : 0));
+      return *this;
+    }
+    bool operator==(const Iterator& other) const { return _index == other._index; }
+
+   private:
+    friend class Value;
+    Iterator(const Tape* tape, size_t index, bool object)
+      : _tape(tape), _index(index), _object(object) {}
+
+    const Tape* _tape;
+    size_t _index;
+    bool _object;
+  };
+
+  // Parses with saxParse, so errors and what is accepted are the same.
+  Tape(const char8_t* first, const char8_t* last);
+  explicit Tape(std::u8string_view json) : Tape(json.data(), json.data() + json.size()) {}
+  explicit Tape(const std::u8string& json) : Tape(std::u8string_view(json)) {}
+  explicit Tape(const YJson& json);
+
+  Value root() const { return Value(this, 0); }
+  YJson toYJson() const { return toYJson(0); }
+  std::u8string toString(bool fmt = false) const { return root().toString(fmt); }
+
+ private:
+  enum Tag : uint8_t { Null, False, True, Double, Int64, UInt64, String, Array, Object, EndArray, EndObject };
+  static constexpr int tagShift = 56;
+  static constexpr uint64_t payloadMask = (uint64_t(1) << tagShift) - 1;
+  struct Builder;
+
+  Tag tag(size_t index) const { return static_cast<Tag>(_words[index] >> tagShift); }
+  uint64_t payload(size_t index) const { return _words[index] & payloadMask; }
+  void push(Tag tag, uint64_t payload = 0) {
+    _words.push_back(static_cast<uint64_t>(tag) << tagShift | payload);
+  }
+  void pushString(std::u8string_view str) {
+    push(String, _strings.size());
+    _words.push_back(str.size());
+    _strings.append(str);
+  }
+  void close(size_t open, Tag tag, size_t count) {
+    push(tag, count);
+    _words[open] = static_cast<uint64_t>(this->tag(open)) << tagShift | _words.size();
+  }
+  std::u8string_view string(size_t index) const {
+    return std::u8string_view(_strings.data() + payload(index), _words[index + 1]);
+  }
+  // Children of the array or object at index.
+  size_t count(size_t index) const { return payload(payload(index) - 1); }
+  // The index just past the value at index.
+  size_t next(size_t index) const {
+    switch (tag(index)) {
+      case Double: case Int64: case UInt64: case String:
+        return index + 2;
+      case Array: case Object:
+        return payload(index);
+      default:
+        return index + 1;
+    }
+  }
+
+  void append(const YJson& value);
+  YJson toYJson(size_t index) const;
+  template <typename _Policy>
+  void printValue(StringSink& pre, size_t index, int depth) const;
+
+  std::vector<uint64_t> _words;
+  std::u8string _strings;
+};
+
+// Writes JSON as it is produced, with no tree in between, to a StringSink,
+// a FileSink or any sink with put(char) and write(const char*, size).
+// Output is laid out as print<_Policy>() would lay it out, except that keys
+// keep the order they are written in. Calls chain:
+//
+//   YJson::Writer writer(sink, YJson::Pretty());
+//   writer.beginObject().key(u8"id").value(7).key(u8"tags").beginArray();
+//
+// Debug builds throw std::logic_error on a key outside an object, a value
+// where a key is due, a mismatched end or a second top-level value.
+template <typename _Sink, typename _Policy>
+class YJson::Writer {
+ public:
+  explicit Writer(_Sink& sink, _Policy = {}) : _sink(sink) {}
+
+  Writer& beginObject() { return open('{', true); }
+  Writer& endObject() { return close('}', true); }
+  Writer& beginArray() { return open('[', false); }
+  Writer& endArray() { return close(']', false); }
+
+  Writer& key(std::u8string_view key) {
+#ifndef NDEBUG
+    if (_objects.empty() || !_objects.back() || _afterKey)
+      throw std::logic_error("YJson Error: Writer key is not expected here.");
+#endif
+    separate();
+    printString<_Policy::ascii>(_sink, key);
+    if constexpr (_Policy::indent > 0) {
+      _sink.write(": ", 2);
+    } else {
+      _sink.put(':');
+    }
+    _afterKey = true;
+    return *this;
+  }
+
+  Writer& value(std::nullptr_t) { return scalar(YJson()); }
+  Writer& value(bool val) { return scalar(YJson(val)); }
+  Writer& value(double val) { return scalar(YJson(val)); }
+  template <std::integral _Ty>
+  Writer& value(_Ty val) { return scalar(YJson(val)); }
+  Writer& value(std::u8string_view str) {
+    prefix();
+    printString<_Policy::ascii>(_sink, str);
+    return *this;
+  }
+  Writer& value(const char8_t* str) { return value(std::u8string_view(str)); }
+  Writer& value(const std::u8string& str) { return value(std::u8string_view(str)); }
+  // A whole tree, nested at the current depth.
+  Writer& value(const YJson& val) {
+    prefix();
+    val.printValue<_Policy>(_sink, _depth);
+    return *this;
+  }
+
+  // True once the top-level value is complete.
+  bool done() const { return _depth == 0 && !_first; }
+
+ private:
+  // Anything but a value that follows its key starts a new line in a
+  // container, after a comma unless it is the first.
+  void separate() {
+    if (_depth != 0)
+      printSeparator<_Policy>(_sink, _depth, !_first);
+  }
+  void prefix() {
+#ifndef NDEBUG
+    if (_objects.empty() ? !_first : _objects.back() && !_afterKey)
+      throw std::logic_error("YJson Error: Writer value is not expected here.");
+#endif
+    if (_afterKey) {
+      _afterKey = false;
+    } else {
+      separate();
+    }
+    _first = false;
+  }
+  Writer& scalar(const YJson& val) {
+    prefix();
+    val.printValue<_Policy>(_sink, _depth);
+    return *this;
+  }
+  Writer& open(char c, [[maybe_unused]] bool object) {
+    prefix();
+    _sink.put(c);
+    ++_depth;
+    _first = true;
+#ifndef NDEBUG
+    _objects.push_back(object);
+#endif
+    return *this;
+  }
+  Writer& close(char c, [[maybe_unused]] bool object) {
+#ifndef NDEBUG
+    if (_objects.empty() || _objects.back() != object || _afterKey)
+      throw std::logic_error("YJson Error: Writer end does not match its begin.");
+    _objects.pop_back();
+#endif
+    if (!_first)
+      printSeparator<_Policy>(_sink, --_depth, false);
+    else
+      --_depth;
+    _sink.put(c);
+    _first = false;
+    return *this;
+  }
+
+  _Sink& _sink;
+  int _depth = 0;
+  // Nothing written yet in the innermost container, or at all at the top.
+  bool _first = true;
+  bool _afterKey = false;
+#ifndef NDEBUG
+  std::vector<bool> _objects;
+#endif
+};
+
+// Buffers output for a file descriptor in a page-aligned buffer and hands
+// it over in large writes. A failed write throws std::system_error. The
+// destructor flushes what is left and ignores errors, so call flush() to
+// see them.
+class YJson::FileSink {
+ public:
+  explicit FileSink(int fd, size_t bufferSize = 64 << 10)
+      : _fd(fd),
+        _buffer(static_cast<char*>(::operator new[](bufferSize, pageAlign))),
+        _capacity(bufferSize) {}
+  FileSink(const FileSink&) = delete;
+  FileSink& operator=(const FileSink&) = delete;
+  ~FileSink() {
+    try {
+      flush();
+    } catch (...) {
+    }
+  }
+
+  void put(char c) {
+    if (_size == _capacity)
+      flush();
+    _buffer[_size++] = c;
+  }
+  void write(const char* data, size_t size) {
+    if (size > _capacity - _size) {
+      flush();
+      if (size >= _capacity)
+        return writeAll(data, size);
+    }
+    std::memcpy(_buffer.get() + _size, data, size);
+    _size += size;
+  }
+  void flush() {
+    const size_t size = std::exchange(_size, 0);
+    writeAll(_buffer.get(), size);
+  }
+  // Bytes taken so far, flushed or not.
+  size_t size() const { return _written + _size; }
+
+ private:
+  static constexpr std::align_val_t pageAlign {4096};
+  struct Delete {
+    void operator()(char* buffer) const { ::operator delete[](buffer, pageAlign); }
+  };
+
+  void writeAll(const char* data, size_t size);
+
+  const int _fd;
+  std::unique_ptr<char[], Delete> _buffer;
+  const size_t _capacity;
+  size_t _size = 0;
+  size_t _written = 0;
+};
+
+// A new file that takes the place of target only on commit(), by a rename
+// within target's directory; until then target is untouched. It keeps
+// target's permissions, and replaces the file a symlink points to rather
+// than the link. An uncommitted file is removed. Errors throw
+// std::system_error.
+class YJson::AtomicFile {
+ public:
+  explicit AtomicFile(const std::filesystem::path& target);
+  AtomicFile(const AtomicFile&) = delete;
+  AtomicFile& operator=(const AtomicFile&) = delete;
+  ~AtomicFile();
+
+  int fd() const { return _fd; }
+  // With sync, the data and then the rename are flushed to disk.
+  void commit(bool sync = false);
+
+ private:
+  std::filesystem::path _target;
+  std::filesystem::path _path;
+  int _fd = -1;
+};
+
+template <typename _Policy>
+YJson::WriteResult YJson::toFile(const std::filesystem::path& file_name,
+                                 const Encode& encode, bool sync) const {
+  WriteResult result;
+  try {
+    AtomicFile file(file_name);
+    size_t bytes;
+    {
+      FileSink sink(file.fd(), 1 << 20);
+      if (encode == UTF8BOM) {
+        sink.write(reinterpret_cast<const char*>(utf8bom.data()), 3);
+      }
+      print<_Policy>(sink);
+      sink.flush();
+      bytes = sink.size();
+    }
+    file.commit(sync);
+    result.bytes = bytes;
+  } catch (const std::system_error& e) {
+    result.error = e.code();
+  }
+  return result;
+}
 
 #endif
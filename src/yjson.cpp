@@ -1,8 +1,44 @@
 #include <yjson/yjson.h>
 
+#include <bit>
 #include <cassert>
-#include <iomanip>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <limits>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#define YJSON_X86 1
+#if defined(__GNUC__) || defined(__clang__)
+#define YJSON_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define YJSON_TARGET_AVX2
+#endif
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define YJSON_MMAP 1
+#endif
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#endif
 
 constexpr std::array<char8_t, 3> YJson::utf8bom;
 // constexpr char8_t YJson::utf16le[];
@@ -10,39 +46,1577 @@ constexpr std::array<char8_t, 3> YJson::utf8bom;
 constexpr std::array<char16_t, 3> YJson::utf16FirstWcharMark;
 constexpr std::array<char8_t, 7> YJson::utf8FirstCharMark;
 
+namespace {
+
+#ifdef YJSON_MMAP
+// A read-only mapping of a whole regular file. Anything else, or a failed
+// mapping, leaves data() null so that the caller can read the file instead.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::filesystem::path& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      return;
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+      void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+        ::madvise(data, st.st_size, MADV_SEQUENTIAL);
+        _data = static_cast<const char8_t*>(data);
+        _size = st.st_size;
+      }
+    }
+    ::close(fd);
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() {
+    if (_data)
+      ::munmap(const_cast<char8_t*>(_data), _size);
+  }
+
+  const char8_t* data() const { return _data; }
+  size_t size() const { return _size; }
+
+ private:
+  const char8_t* _data = nullptr;
+  size_t _size = 0;
+};
+#endif
+
+// Reads the rest of a stream, which need not be seekable.
+std::u8string readFile(std::ifstream& file) {
+  constexpr size_t chunkSize = 1 << 16;
+  std::u8string json;
+  if (file.seekg(0, std::ios::end)) {
+    const std::streamoff size = file.tellg();
+    if (size > 0 && static_cast<size_t>(size) < json.max_size() - chunkSize)
+      json.reserve(size + chunkSize);
+    file.seekg(0, std::ios::beg);
+  }
+  file.clear();
+  size_t size = 0;
+  do {
+    json.resize(size + chunkSize);
+    file.read(reinterpret_cast<char *>(json.data() + size), chunkSize);
+    size += file.gcount();
+  } while (file);
+  json.resize(size);
+  return json;
+}
+
+}  // namespace
+
 YJson::YJson(const std::filesystem::path& path, YJson::Encode encode): _type(Null) {
+  const auto parseFile = [this, encode](const char8_t* first, const char8_t* last) {
+    switch (encode) {
+      case YJson::UTF8BOM:
+        if (last - first < 3) {
+          throw std::runtime_error("YJson Error: File does not begin with UTF-8 BOM.");
+        }
+        first += 3;
+        break;
+      case YJson::UTF8:
+        break;
+      default:
+        throw std::runtime_error("YJson Error: File encoding format not supported.");
+    }
+    parseIndexed(first, last);
+  };
+
+#ifdef YJSON_MMAP
+  // Regular files are parsed straight from the page cache.
+  const MappedFile mapping(path);
+  if (mapping.data()) {
+    parseFile(mapping.data(), mapping.data() + mapping.size());
+    return;
+  }
+#endif
   std::ifstream file(path, std::ios::in | std::ios::binary);
   if (!file.is_open()) {
     throw std::runtime_error("YJson Error: File does not exist.");
   }
-  file.seekg(0, std::ios::end);
-  size_t size = file.tellg();
-  file.seekg(0, std::ios::beg);
-  switch (encode) {
-    case YJson::UTF8BOM: {
-      if (size < 3) {
-        throw std::runtime_error("YJson Error: File does not begin with UTF-8 BOM.");
+  const std::u8string json_string = readFile(file);
+  file.close();
+  parseFile(json_string.data(), json_string.data() + json_string.size());
+}
+
+namespace {
+
+// Stage 1 of the indexed parser: every 64-byte block is reduced to bit masks,
+// one bit per byte, which are then turned into the offsets of all tokens.
+struct BlockMasks {
+  uint64_t space;      // bytes <= 32, the same set StrSkip skips
+  uint64_t op;         // { } [ ] : ,
+  uint64_t quote;
+  uint64_t backslash;
+};
+
+typedef BlockMasks (*BlockClassifier)(const char8_t* block);
+
+enum CharClass : uint8_t { kSpace = 1, kOp = 2, kQuote = 4, kBackslash = 8 };
+
+constexpr std::array<uint8_t, 256> charClassTable = [] {
+  std::array<uint8_t, 256> table {};
+  for (int i = 0; i <= 32; ++i)
+    table[i] = kSpace;
+  for (const auto c : "{}[]:,"sv)
+    table[static_cast<uint8_t>(c)] = kOp;
+  table['"'] = kQuote;
+  table['\\'] = kBackslash;
+  return table;
+}();
+
+[[maybe_unused]] BlockMasks classifyScalar(const char8_t* block) {
+  BlockMasks masks {};
+  for (int i = 0; i < 64; ++i) {
+    const uint64_t bit = uint64_t(1) << i;
+    switch (charClassTable[block[i]]) {
+      case kSpace: masks.space |= bit; break;
+      case kOp: masks.op |= bit; break;
+      case kQuote: masks.quote |= bit; break;
+      case kBackslash: masks.backslash |= bit; break;
+      default: break;
+    }
+  }
+  return masks;
+}
+
+#ifdef YJSON_SSE2
+BlockMasks classifySse2(const char8_t* block) {
+  BlockMasks masks {};
+  const __m128i space = _mm_set1_epi8(32);
+  const __m128i lower = _mm_set1_epi8(0x20);
+  const __m128i brace = _mm_set1_epi8('{');
+  const __m128i brace2 = _mm_set1_epi8('}');
+  const __m128i colon = _mm_set1_epi8(':');
+  const __m128i comma = _mm_set1_epi8(',');
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  for (int i = 0; i < 64; i += 16) {
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+    // '[' and ']' become '{' and '}' once bit 5 is set.
+    const __m128i folded = _mm_or_si128(x, lower);
+    const __m128i op = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(folded, brace), _mm_cmpeq_epi8(folded, brace2)),
+        _mm_or_si128(_mm_cmpeq_epi8(x, colon), _mm_cmpeq_epi8(x, comma)));
+    const __m128i ws = _mm_cmpeq_epi8(_mm_min_epu8(x, space), x);
+    masks.space |= uint64_t(uint16_t(_mm_movemask_epi8(ws))) << i;
+    masks.op |= uint64_t(uint16_t(_mm_movemask_epi8(op))) << i;
+    masks.quote |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(x, quote)))) << i;
+    masks.backslash |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(x, backslash)))) << i;
+  }
+  return masks;
+}
+#endif
+
+#ifdef YJSON_X86
+YJSON_TARGET_AVX2 BlockMasks classifyAvx2(const char8_t* block) {
+  BlockMasks masks {};
+  const __m256i space = _mm256_set1_epi8(32);
+  const __m256i lower = _mm256_set1_epi8(0x20);
+  const __m256i brace = _mm256_set1_epi8('{');
+  const __m256i brace2 = _mm256_set1_epi8('}');
+  const __m256i colon = _mm256_set1_epi8(':');
+  const __m256i comma = _mm256_set1_epi8(',');
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  for (int i = 0; i < 64; i += 32) {
+    const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+    const __m256i folded = _mm256_or_si256(x, lower);
+    const __m256i op = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(folded, brace), _mm256_cmpeq_epi8(folded, brace2)),
+        _mm256_or_si256(_mm256_cmpeq_epi8(x, colon), _mm256_cmpeq_epi8(x, comma)));
+    const __m256i ws = _mm256_cmpeq_epi8(_mm256_min_epu8(x, space), x);
+    masks.space |= uint64_t(uint32_t(_mm256_movemask_epi8(ws))) << i;
+    masks.op |= uint64_t(uint32_t(_mm256_movemask_epi8(op))) << i;
+    masks.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, quote)))) << i;
+    masks.backslash |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, backslash)))) << i;
+  }
+  return masks;
+}
+
+bool cpuHasAvx2() {
+#if defined(__GNUC__) || defined(__clang__)
+  // We may run from a static initializer, before libgcc has probed the CPU.
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+  __cpuid(info, 1);
+  // OSXSAVE and AVX, then check that the OS saves the YMM state.
+  if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+    return false;
+  if ((_xgetbv(0) & 6) != 6)
+    return false;
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return false;
+#endif
+}
+#endif
+
+BlockClassifier selectClassifier() {
+#ifdef YJSON_X86
+  if (cpuHasAvx2())
+    return classifyAvx2;
+#endif
+#ifdef YJSON_SSE2
+  return classifySse2;
+#else
+  return classifyScalar;
+#endif
+}
+
+// Chosen on first use rather than at static initialization, so that trees
+// parsed from the static initializers of other translation units get it too.
+BlockClassifier blockClassifier() {
+  static const BlockClassifier classifier = selectClassifier();
+  return classifier;
+}
+
+// Length of the leading run without quotes or brackets, for Lazy::skipValue.
+size_t bracketRun(const char8_t* first, const char8_t* last) {
+  const char8_t* ptr = first;
+#ifdef YJSON_SSE2
+  const __m128i lower = _mm_set1_epi8(0x20);
+  const __m128i brace = _mm_set1_epi8('{');
+  const __m128i brace2 = _mm_set1_epi8('}');
+  const __m128i quote = _mm_set1_epi8('"');
+  for (; last - ptr >= 16; ptr += 16) {
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+    const __m128i folded = _mm_or_si128(x, lower);
+    const unsigned mask = _mm_movemask_epi8(_mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(folded, brace), _mm_cmpeq_epi8(folded, brace2)),
+        _mm_cmpeq_epi8(x, quote)));
+    if (mask)
+      return ptr - first + std::countr_zero(mask);
+  }
+#endif
+  while (ptr != last && charClassTable[*ptr] != kQuote && *ptr != '[' && *ptr != ']' &&
+         *ptr != '{' && *ptr != '}')
+    ++ptr;
+  return ptr - first;
+}
+
+// Counts of the bytes of [first, last) in each class that sizes a tape,
+// inside strings or not.
+struct ByteCounts {
+  size_t op = 0;
+  size_t quote = 0;
+};
+
+ByteCounts countBytes(const char8_t* first, const char8_t* last) {
+  ByteCounts counts;
+  const BlockClassifier classifyBlock = blockClassifier();
+  for (; last - first >= 64; first += 64) {
+    const BlockMasks masks = classifyBlock(first);
+    counts.op += std::popcount(masks.op);
+    counts.quote += std::popcount(masks.quote);
+  }
+  for (; first != last; ++first) {
+    counts.op += (charClassTable[*first] & kOp) != 0;
+    counts.quote += (charClassTable[*first] & kQuote) != 0;
+  }
+  return counts;
+}
+
+uint64_t prefixXor(uint64_t x) {
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+}
+
+}  // namespace
+
+// Offsets of every token: structural characters, opening quotes and the first
+// byte of each run of scalar characters (numbers, literals, garbage). Stage 1
+// runs one window ahead of the walker into a fixed buffer, which keeps the
+// offsets in cache and stays away from the heap the tree is built on. The
+// last token is the size of the input, as a sentinel.
+class YJson::StructuralIndex {
+ public:
+  StructuralIndex(const char8_t* first, const char8_t* last, std::pmr::memory_resource* resource)
+    : _first(first), _last(last), _resource(resource) {}
+
+  // Builds the tree the same way parseValue would. Returns false as soon as the
+  // input leaves the happy path, so that the caller can redo it char by char
+  // and throw exactly the same error.
+  bool walk(YJson& value) { return walkValue(value); }
+
+ private:
+  static constexpr size_t windowSize = 4096;
+
+  void scanWindow() {
+    const size_t size = _last - _first;
+    const size_t stop = std::min(size, _scanned + windowSize);
+    const BlockClassifier classifyBlock = blockClassifier();
+    for (; _scanned < stop; _scanned += 64) {
+      BlockMasks masks;
+      if (size - _scanned >= 64) {
+        masks = classifyBlock(_first + _scanned);
+      } else {
+        char8_t tail[64];
+        std::memset(tail, ' ', sizeof tail);
+        std::memcpy(tail, _first + _scanned, size - _scanned);
+        masks = classifyBlock(tail);
+      }
+
+      // A backslash escapes the byte after it unless it is escaped itself.
+      uint64_t escaped = _escapedCarry;
+      _escapedCarry = 0;
+      for (uint64_t starts = masks.backslash & ~escaped; starts; ) {
+        const int i = std::countr_zero(starts);
+        if (i == 63) {
+          _escapedCarry = 1;
+          break;
+        }
+        escaped |= uint64_t(2) << i;
+        starts &= ~(uint64_t(3) << i);
+      }
+
+      const uint64_t quote = masks.quote & ~escaped;
+      // Set from an opening quote up to, but excluding, its closing quote.
+      const uint64_t inString = prefixXor(quote) ^ _stringCarry;
+      _stringCarry = uint64_t(static_cast<int64_t>(inString) >> 63);
+
+      const uint64_t scalar = ~(inString | masks.space | masks.op | quote);
+      const uint64_t scalarStart = scalar & ~((scalar << 1) | _scalarCarry);
+      _scalarCarry = scalar >> 63;
+
+      uint64_t bits = (masks.op & ~inString) | (quote & inString) | scalarStart;
+      if (size - _scanned < 64)
+        bits &= (uint64_t(1) << (size - _scanned)) - 1;
+      for (; bits; bits &= bits - 1) {
+        _tokens[_count++] = static_cast<uint32_t>(_scanned + std::countr_zero(bits));
+      }
+    }
+    if (_scanned >= size)
+      _tokens[_count++] = static_cast<uint32_t>(size);
+  }
+
+  // Offset of the token `ahead` places after the current one.
+  uint32_t token(size_t ahead = 0) {
+    while (_next + ahead >= _count) {
+      std::copy(_tokens + _next, _tokens + _count, _tokens);
+      _count -= _next;
+      _next = 0;
+      scanWindow();
+    }
+    return _tokens[_next + ahead];
+  }
+
+  bool atEnd() { return _first + token() == _last; }
+  char8_t current() { return _first[token()]; }
+  bool advance() { ++_next; return !atEnd(); }
+
+  // A scalar must be followed by whitespace or directly by the next token.
+  bool skipScalar(const char8_t* end) {
+    const char8_t* next = _first + token(1);
+    if (end != next && (end > next || *end > 32))
+      return false;
+    ++_next;
+    return true;
+  }
+
+  bool walkValue(YJson& value) {
+    if (atEnd())
+      return false;
+    const char8_t* first = _first + token();
+    switch (*first) {
+      case '\"': {
+        value._type = YJson::String;
+        if (_resource != std::pmr::get_default_resource()) {
+          if (const auto end = plainString(first, _last)) {
+            value.setString(std::u8string_view(first + 1, end), _resource);
+            return skipScalar(end + 1);
+          }
+        }
+        std::u8string buffer;
+        const auto end = parseString(buffer, first, _last);
+        if (_resource == std::pmr::get_default_resource())
+          value.setString(std::move(buffer));
+        else
+          value.setString(buffer, _resource);
+        return skipScalar(end);
       }
-      size -= 3;
-      std::u8string json_string(size, u8'\0');
-      file.seekg(3, std::ios::beg);
-      file.read(reinterpret_cast<char *>(json_string.data()), size);
-      file.close();
-      auto first = StrSkip(json_string.begin(), json_string.end());
-      parseValue(first, json_string.end());
+      case '[': {
+        ArrayType buffer(_resource);
+        if (!walkArray(buffer))
+          return false;
+        value._type = YJson::Array;
+        value._value.Array = newContainer(std::move(buffer));
+        return true;
+      }
+      case '{': {
+        ObjectType buffer(_resource);
+        if (!walkObject(buffer))
+          return false;
+        value._type = YJson::Object;
+        value.setObject(newContainer(std::move(buffer)));
+        return true;
+      }
+      case 'n':
+      case 't':
+        if (_last - first < 4)
+          return false;
+        if (std::equal(first, first + 4, "null")) {
+          value._type = YJson::Null;
+        } else if (std::equal(first, first + 4, "true")) {
+          value._type = YJson::True;
+        } else {
+          return false;
+        }
+        return skipScalar(first + 4);
+      case 'f':
+        if (_last - first < 5 || !std::equal(first, first + 5, "false"))
+          return false;
+        value._type = YJson::False;
+        return skipScalar(first + 5);
+      default:
+        if (*first == '-' || (*first >= '0' && *first <= '9')) {
+          return skipScalar(value.parseNumberValue(first, _last));
+        }
+        return false;
+    }
+  }
+
+  // The elements of every open array are collected on one shared stack, so
+  // that each array is allocated once, at its exact size, when it closes.
+  bool walkArray(ArrayType& buffer) {
+    if (!advance())
+      return false;
+    if (current() == ']')
+      return ++_next, true;
+    const size_t base = _elements.size();
+    for (;;) {
+      YJson value;
+      if (!walkValue(value) || atEnd())
+        break;
+      _elements.push_back(std::move(value));
+      if (current() == ',') {
+        if (!advance())
+          break;
+        if (current() != ']')
+          continue;
+      } else if (current() != ']') {
+        break;
+      }
+      ++_next;
+      buffer.assign(std::make_move_iterator(_elements.begin() + base),
+                    std::make_move_iterator(_elements.end()));
+      _elements.erase(_elements.begin() + base, _elements.end());
+      return true;
+    }
+    _elements.erase(_elements.begin() + base, _elements.end());
+    return false;
+  }
+
+  bool walkObject(ObjectType& buffer) {
+    if (!advance())
+      return false;
+    if (current() == '}')
+      return ++_next, true;
+    for (;;) {
+      if (current() != '\"')
+        return false;
+      buffer.emplace_back();
+      const auto end = parseKey(buffer.back().first, _first + token(), _last, _resource);
+      if (!skipScalar(end) || atEnd() || current() != ':' || !advance())
+        return false;
+      if (!walkValue(buffer.back().second) || atEnd())
+        return false;
+      if (current() == '}')
+        return ++_next, true;
+      if (current() != ',' || !advance())
+        return false;
+      if (current() == '}')
+        return ++_next, true;
+    }
+  }
+
+  const char8_t* const _first;
+  const char8_t* const _last;
+  std::pmr::memory_resource* const _resource;
+  // One full window plus what is left of the previous one.
+  uint32_t _tokens[windowSize + 2];
+  size_t _count = 0;
+  size_t _next = 0;
+  size_t _scanned = 0;
+  uint64_t _escapedCarry = 0;
+  uint64_t _stringCarry = 0;
+  uint64_t _scalarCarry = 0;
+  // Elements of the arrays still open, innermost last.
+  std::vector<YJson> _elements;
+};
+
+void YJson::parseIndexed(const char8_t* first, const char8_t* last, std::pmr::memory_resource* resource) {
+  // Small inputs are not worth the index, and offsets are 32 bits wide.
+  constexpr size_t minIndexedSize = 256;
+  const size_t size = last - first;
+  if (size < minIndexedSize || size >= std::numeric_limits<uint32_t>::max()) {
+    parseValue(StrSkip(first, last), last, resource);
+    return;
+  }
+  YJson value;
+  if (StructuralIndex(first, last, resource).walk(value)) {
+    swap(value);
+  } else {
+    parseValue(StrSkip(first, last), last, resource);
+  }
+}
+
+YJson::YJson(std::pmr::memory_resource* resource, const char8_t* first, const char8_t* last): YJson() {
+  if (first >= last) {
+    throw std::logic_error("YJson Error: The iterator range is wrong.");
+  }
+  parseIndexed(first, last, resource);
+}
+
+YJson::YJson(std::pmr::memory_resource* resource, const YJson& other): _type(other._type) {
+  switch (_type) {
+    case YJson::Array: {
+      ArrayType array(resource);
+      array.reserve(other._value.Array->size());
+      for (const auto& item: *other._value.Array)
+        array.emplace_back(resource, item);
+      _value.Array = newContainer(std::move(array));
       break;
     }
-    case YJson::UTF8: {
-      std::u8string json_string(size, u8'\0');
-      file.read(reinterpret_cast<char *>(json_string.data()), size);
-      file.close();
-      auto first = StrSkip(json_string.begin(), json_string.end());
-      parseValue(first, json_string.end());
+    case YJson::Object: {
+      ObjectType object(resource);
+      for (const auto& [key, value]: *other._value.Object) {
+        object.emplace_back(std::piecewise_construct, std::forward_as_tuple(key, *resource),
+                            std::forward_as_tuple(resource, value));
+      }
+      setObject(newContainer(std::move(object)));
+      break;
+    }
+    case YJson::String:
+      setString(other.stringView(), resource);
+      break;
+    case YJson::Number:
+      _storage = other._storage;
+      _value = other._value;
       break;
+    default:
+      break;
+  }
+}
+
+void* YJson::Arena::do_allocate(size_t bytes, size_t alignment) {
+  constexpr size_t maxBlockSize = 4 << 20;
+  for (;;) {
+    if (_first) {
+      const size_t padding = -reinterpret_cast<uintptr_t>(_first) & (alignment - 1);
+      if (padding + bytes <= static_cast<size_t>(_last - _first)) {
+        char* const result = _first + padding;
+        _first = result + bytes;
+        _used += bytes;
+        _wasted += padding;
+        return result;
+      }
+      _wasted += _last - _first;
+      ++_current;
+    }
+    if (_current == _blocks.size()) {
+      const size_t size = std::max(_blockSize, bytes + alignment);
+      _blocks.push_back(Block { static_cast<char*>(::operator new(size)), size });
+      _capacity += size;
+      _blockSize = std::min(_blockSize * 2, std::max(_blockSize, maxBlockSize));
+    }
+    _first = _blocks[_current].data;
+    _last = _first + _blocks[_current].size;
+  }
+}
+
+const char8_t* YJson::Key::store(std::u8string_view str, std::pmr::memory_resource& resource) {
+  if (const auto table = dynamic_cast<KeyTable*>(&resource))
+    return table->intern(str).data();
+  if (!holdsText(&resource))
+    return nullptr;
+  const auto data = static_cast<char8_t*>(resource.allocate(str.size(), 1));
+  std::memcpy(data, str.data(), str.size());
+  return data;
+}
+
+bool YJson::holdsText(std::pmr::memory_resource* resource) {
+  return dynamic_cast<Arena*>(resource) != nullptr;
+}
+
+std::u8string_view YJson::KeyTable::intern(std::u8string_view key) {
+  if (const auto iter = _keys.find(key); iter != _keys.end())
+    return *iter;
+  const auto data = static_cast<char8_t*>(_bytes.allocate(key.size(), 1));
+  std::copy(key.begin(), key.end(), data);
+  return *_keys.emplace(data, key.size()).first;
+}
+
+void YJson::Arena::reset() {
+  _current = 0;
+  _first = _last = nullptr;
+  _used = _wasted = 0;
+}
+
+void YJson::Arena::release() {
+  for (const auto& block: _blocks)
+    ::operator delete(block.data);
+  _blocks.clear();
+  _capacity = 0;
+  reset();
+}
+
+// Returns the end of the string, or null if it goes on past this chunk.
+const char8_t* YJson::PushParser::scanString(const char8_t* first, const char8_t* last) {
+  if (_escaped) {
+    if (first == last)
+      return nullptr;
+    ++first;
+    _escaped = false;
+  }
+  for (;;) {
+    first += plainRun(first, last);
+    if (first == last)
+      return nullptr;
+    if (*first == '\"')
+      return first + 1;
+    if (++first == last) {
+      _escaped = true;
+      return nullptr;
     }
+    ++first;
+  }
+}
+
+// Returns the end of the number or literal, or null if the chunk ends first.
+const char8_t* YJson::PushParser::scanScalar(const char8_t* first, const char8_t* last) {
+  for (; first != last; ++first) {
+    if (*first <= 32 || u8",:[]{}\""sv.find(*first) != std::u8string_view::npos)
+      return first;
+  }
+  return nullptr;
+}
+
+void YJson::PushParser::endToken(const char8_t* first, const char8_t* last) {
+  if (_state == ExpectKey || _state == ExpectKeyOrEnd) {
+    Key key;
+    parseKey(key, first, last);
+    _stack.back()->_value.Object->emplace_back(std::move(key), YJson());
+    _state = ExpectColon;
+    return;
+  }
+  if (nextValue().parseValue(first, last) != last) {
+    throw std::runtime_error("YJson Error: Invalid value.");
+  }
+  endValue();
+}
+
+YJson& YJson::PushParser::nextValue() {
+  if (_stack.empty())
+    return _root;
+  YJson& parent = *_stack.back();
+  if (parent._type == YJson::Array)
+    return parent._value.Array->emplace_back();
+  return parent._value.Object->back().second;
+}
+
+void YJson::PushParser::open(YJson::Type type) {
+  YJson& value = nextValue();
+  value = type;
+  _stack.push_back(&value);
+  _state = type == YJson::Array ? ExpectValueOrEnd : ExpectKeyOrEnd;
+}
+
+void YJson::PushParser::close(char8_t c) {
+  if (_stack.back()->_type == YJson::Array) {
+    if (c != ']')
+      throw std::runtime_error("YJson Error: Array missing right square brackets.");
+  } else if (c != '}') {
+    throw std::runtime_error("YJson Error: Invalid Object.");
+  } else {
+    _stack.back()->indexObject();
+  }
+  _stack.pop_back();
+  endValue();
+}
+
+void YJson::PushParser::feed(const char8_t* data, size_t size) {
+  const char8_t* ptr = data;
+  const char8_t* const last = data + size;
+  // Start of a token that began in this chunk, which is parsed in place
+  // unless it runs into the next one.
+  const char8_t* token = nullptr;
+  while (ptr != last) {
+    if (_token != NoToken) {
+      const char8_t* end = _token == StringToken ? scanString(ptr, last) : scanScalar(ptr, last);
+      if (!end) {
+        _buffer.append(token ? token : ptr, last);
+        return;
+      }
+      if (token) {
+        endToken(token, end);
+      } else {
+        _buffer.append(ptr, end);
+        endToken(_buffer.data(), _buffer.data() + _buffer.size());
+        _buffer.clear();
+      }
+      _token = NoToken;
+      token = nullptr;
+      ptr = end;
+      continue;
+    }
+
+    const char8_t c = *ptr;
+    if (c <= 32) {
+      ++ptr;
+      continue;
+    }
+    switch (_state) {
+      case ExpectColon:
+        if (c != ':')
+          throw std::runtime_error("YJson Error: Invalid Object.");
+        _state = ExpectValue;
+        ++ptr;
+        continue;
+      case ExpectCommaOrEnd:
+        if (c == ',') {
+          _state = _stack.back()->_type == YJson::Array ? ExpectValueOrEnd : ExpectKeyOrEnd;
+        } else {
+          close(c);
+        }
+        ++ptr;
+        continue;
+      case ExpectKeyOrEnd:
+        if (c == '}') {
+          close(c);
+          ++ptr;
+          continue;
+        }
+        [[fallthrough]];
+      case ExpectKey:
+        if (c != '\"')
+          throw std::runtime_error("YJson Error: Invalid Object.");
+        _token = StringToken;
+        token = ptr++;
+        continue;
+      case ExpectValueOrEnd:
+        if (c == ']') {
+          close(c);
+          ++ptr;
+          continue;
+        }
+        [[fallthrough]];
+      case ExpectValue:
+        if (c == '[' || c == '{') {
+          open(c == '[' ? YJson::Array : YJson::Object);
+          ++ptr;
+        } else if (c == '\"') {
+          _token = StringToken;
+          token = ptr++;
+        } else if (scanScalar(ptr, ptr + 1) == nullptr) {
+          _token = ScalarToken;
+          token = ptr;
+        } else {
+          throw std::runtime_error("YJson Error: Parse empty data!");
+        }
+        continue;
+      case Complete:
+      default:
+        throw std::runtime_error("YJson Error: Unexpected data after the value.");
+    }
+  }
+  if (token)
+    _buffer.append(token, last);
+}
+
+YJson YJson::PushParser::finish() {
+  if (_token == ScalarToken) {
+    _token = NoToken;
+    endToken(_buffer.data(), _buffer.data() + _buffer.size());
+    _buffer.clear();
+  } else if (_token == StringToken) {
+    throw std::runtime_error("YJson Error: String missing right quotes.");
+  }
+  if (_state != Complete) {
+    if (_stack.empty())
+      throw std::runtime_error("YJson Error: Parse empty data!");
+    if (_stack.back()->_type == YJson::Array)
+      throw std::runtime_error("YJson Error: Array missing right square brackets.");
+    throw std::runtime_error("YJson Error: Object missing right brace.");
+  }
+  YJson value(std::move(_root));
+  reset();
+  return value;
+}
+
+void YJson::PushParser::reset() {
+  _root.setNull();
+  _stack.clear();
+  _buffer.clear();
+  _state = ExpectValue;
+  _token = NoToken;
+  _escaped = false;
+}
+
+YJson::Lazy::Lazy(const char8_t* first, const char8_t* last)
+  : _first(StrSkip(first, last)), _last(last) {
+  while (_last != _first && _last[-1] <= 32)
+    --_last;
+  if (_first == _last) {
+    throw std::runtime_error("YJson Error: Parse empty data!");
+  }
+  if (*_first == '[' || *_first == '{')
+    _scan = _first + 1;
+}
+
+YJson::Type YJson::Lazy::type() const {
+  switch (*_first) {
+    case '{':
+      return YJson::Object;
+    case '[':
+      return YJson::Array;
+    case '\"':
+      return YJson::String;
+    case 't':
+      return YJson::True;
+    case 'f':
+      return YJson::False;
+    case 'n':
+      return YJson::Null;
     default:
-      throw std::runtime_error("YJson Error: File encoding format not supported.");
+      return YJson::Number;
+  }
+}
+
+YJson::Lazy* YJson::Lazy::find(std::u8string_view key) {
+  if (*_first != '{') {
+    throw std::logic_error("YJson Error: YJson instance type is not YJson::Object.");
   }
+  for (const auto& member : _members) {
+    if (member->key == key)
+      return &member->value;
+  }
+  while (scanNext()) {
+    if (_members.back()->key == key)
+      return &_members.back()->value;
+  }
+  return nullptr;
+}
+
+YJson::Lazy& YJson::Lazy::operator[](std::u8string_view key) {
+  if (Lazy* value = find(key))
+    return *value;
+  throw std::runtime_error("YJson Error: Key does not exist.");
+}
+
+YJson::Lazy& YJson::Lazy::operator[](size_t index) {
+  if (*_first != '[' && *_first != '{') {
+    throw std::logic_error("YJson Error: YJson instance type is not YJson::Array.");
+  }
+  while (index >= _members.size() && scanNext())
+    ;
+  if (index >= _members.size()) {
+    throw std::runtime_error("YJson Error: Index out of range.");
+  }
+  return _members[index]->value;
+}
+
+size_t YJson::Lazy::size() {
+  while (scanNext())
+    ;
+  return _members.size();
+}
+
+const YJson& YJson::Lazy::value() {
+  if (!_value)
+    _value = std::make_unique<YJson>(_first, _last);
+  return *_value;
+}
+
+// Finds the next member or element and its extent. Returns false at the end.
+bool YJson::Lazy::scanNext() {
+  if (!_scan)
+    return false;
+  const bool isObject = *_first == '{';
+  const char8_t close = isObject ? '}' : ']';
+  const char8_t* ptr = StrSkip(_scan, _last);
+  if (!_members.empty() && ptr != _last && *ptr == ',') {
+    ptr = StrSkip(ptr + 1, _last);
+  } else if (!_members.empty() && (ptr == _last || *ptr != close)) {
+    goto missing;
+  }
+  if (ptr == _last) {
+    goto missing;
+  }
+  if (*ptr == close) {
+    _scan = nullptr;
+    return false;
+  }
+
+  {
+    Key key;
+    if (isObject) {
+      if (*ptr != '\"') {
+        goto invalid;
+      }
+      ptr = StrSkip(parseKey(key, ptr, _last), _last);
+      if (ptr == _last || *ptr != ':') {
+        goto invalid;
+      }
+      ptr = StrSkip(ptr + 1, _last);
+    }
+    const char8_t* end = skipValue(ptr, _last);
+    _members.push_back(std::make_unique<Member>(std::move(key), Lazy(ptr, end)));
+    _scan = end;
+    return true;
+  }
+missing:
+  if (isObject)
+    throw std::runtime_error("YJson Error: Object missing right brace.");
+  throw std::runtime_error("YJson Error: Array missing right square brackets.");
+invalid:
+  throw std::runtime_error("YJson Error: Invalid Object.");
+}
+
+const char8_t* YJson::Lazy::skipString(const char8_t* first, const char8_t* last) {
+  for (++first;;) {
+    first += plainRun(first, last);
+    if (first == last) {
+      throw std::runtime_error("YJson Error: String missing right quotes.");
+    }
+    if (*first == '\"')
+      return first + 1;
+    if (last - first < 2) {
+      throw std::runtime_error("YJson Error: String's length was too short to be parsed.");
+    }
+    first += 2;
+  }
+}
+
+// End of the value at first. Only quotes and brackets are looked at.
+const char8_t* YJson::Lazy::skipValue(const char8_t* first, const char8_t* last) {
+  if (first == last)
+    return first;
+  if (*first == '\"')
+    return skipString(first, last);
+  if (*first != '[' && *first != '{') {
+    while (first != last && *first > 32 && *first != ',' && *first != ']' && *first != '}')
+      ++first;
+    return first;
+  }
+  const bool isObject = *first == '{';
+  size_t depth = 0;
+  while ((first += bracketRun(first, last)) != last) {
+    switch (*first) {
+      case '\"':
+        first = skipString(first, last);
+        continue;
+      case '[':
+      case '{':
+        ++depth;
+        break;
+      case ']':
+      case '}':
+        if (--depth == 0)
+          return first + 1;
+        break;
+      default:
+        break;
+    }
+    ++first;
+  }
+  if (isObject)
+    throw std::runtime_error("YJson Error: Object missing right brace.");
+  throw std::runtime_error("YJson Error: Array missing right square brackets.");
+}
+
+// Writes the tape as saxParse reads. Each open container's word holds the
+// index of the one around it, plus one, until it is closed, so the tape is
+// its own stack.
+struct YJson::Tape::Builder: YJson::SaxHandler {
+  Tape& tape;
+  size_t open = 0;
+
+  bool onNull() { tape.push(Null); return true; }
+  bool onBool(bool value) { tape.push(value ? True : False); return true; }
+  bool onNumber(double value) { return onBits(Double, std::bit_cast<uint64_t>(value)); }
+  bool onInteger(int64_t value) { return onBits(Int64, static_cast<uint64_t>(value)); }
+  bool onUnsigned(uint64_t value) { return onBits(UInt64, value); }
+  bool onString(std::u8string_view str) { tape.pushString(str); return true; }
+  bool onKey(std::u8string_view key) { tape.pushString(key); return true; }
+  bool onStartObject() { return start(Object); }
+  bool onEndObject() { return end(EndObject); }
+  bool onStartArray() { return start(Array); }
+  bool onEndArray() { return end(EndArray); }
+
+  bool onBits(Tag tag, uint64_t bits) {
+    tape.push(tag);
+    tape._words.push_back(bits);
+    return true;
+  }
+  bool start(Tag tag) {
+    tape.push(tag, open);
+    open = tape._words.size();
+    return true;
+  }
+  bool end(Tag tag) {
+    const size_t index = open - 1;
+    open = tape.payload(index);
+    const bool object = tag == EndObject;
+    size_t count = 0;
+    for (size_t i = index + 1; i != tape._words.size(); i = tape.next(i + (object ? 2 : 0)))
+      ++count;
+    tape.close(index, tag, count);
+    return true;
+  }
+};
+
+// Every value and key but the first follows a bracket, colon or comma of its
+// own and takes at most two words. Each quote is a byte that is not decoded
+// text, or an escaped one that decodes from two bytes to one. So one pass
+// over the structural masks bounds both buffers, which never grow.
+YJson::Tape::Tape(const char8_t* first, const char8_t* last) {
+  if (first < last) {
+    const ByteCounts counts = countBytes(first, last);
+    _words.reserve(2 * (counts.op + 1));
+    _strings.reserve((last - first) - counts.quote);
+  }
+  Builder builder {{}, *this};
+  saxParse(first, last, builder);
+}
+
+YJson::Tape::Tape(const YJson& json) {
+  append(json);
+}
+
+void YJson::Tape::append(const YJson& value) {
+  switch (value._type) {
+    case YJson::Null:
+      push(Null);
+      break;
+    case YJson::False:
+      push(False);
+      break;
+    case YJson::True:
+      push(True);
+      break;
+    case YJson::Number:
+      push(value._storage == YJson::Int64 ? Int64 : value._storage == YJson::UInt64 ? UInt64 : Double);
+      _words.push_back(value._value.UInt);
+      break;
+    case YJson::String:
+      pushString(value.stringView());
+      break;
+    case YJson::Array: {
+      const size_t open = _words.size();
+      push(Array);
+      for (const auto& item: *value._value.Array)
+        append(item);
+      close(open, EndArray, value._value.Array->size());
+      break;
+    }
+    case YJson::Object: {
+      const size_t open = _words.size();
+      push(Object);
+      for (const auto& [key, item]: *value._value.Object) {
+        pushString(key);
+        append(item);
+      }
+      close(open, EndObject, value._value.Object->size());
+      break;
+    }
+    default:
+      throw std::runtime_error("YJson Error: Unknown yjson type.");
+  }
+}
+
+YJson YJson::Tape::toYJson(size_t index) const {
+  switch (tag(index)) {
+    case Null:
+      return YJson(nullptr);
+    case False:
+      return YJson(false);
+    case True:
+      return YJson(true);
+    case Double:
+      return YJson(std::bit_cast<double>(_words[index + 1]));
+    case Int64:
+      return YJson(static_cast<int64_t>(_words[index + 1]));
+    case UInt64:
+      return YJson(_words[index + 1]);
+    case String:
+      return YJson(string(index));
+    case Array: {
+      ArrayType array;
+      array.reserve(count(index));
+      for (size_t i = index + 1; tag(i) != EndArray; i = next(i))
+        array.emplace_back(toYJson(i));
+      return YJson(std::move(array));
+    }
+    case Object: {
+      ObjectType object;
+      for (size_t i = index + 1; tag(i) != EndObject; i = next(i + 2))
+        object.emplace_back(string(i), toYJson(i + 2));
+      return YJson(std::move(object));
+    }
+    default:
+      throw std::runtime_error("YJson Error: Unknown yjson type.");
+  }
+}
+
+// Scalars are printed by YJson itself, as a node holding one does not
+// allocate, and containers the way printArray and printObject print them,
+// apart from sorting keys.
+template <typename _Policy>
+void YJson::Tape::printValue(StringSink& pre, size_t index, int depth) const {
+  const Tag type = tag(index);
+  if (type == String) {
+    printString<_Policy::ascii>(pre, string(index));
+    return;
+  }
+  if (type != Array && type != Object) {
+    toYJson(index).printValue<_Policy>(pre, depth);
+    return;
+  }
+  const bool object = type == Object;
+  const size_t end = payload(index) - 1;
+  size_t i = index + 1;
+  if (i == end) {
+    pre.write(object ? "{}" : "[]", 2);
+    return;
+  }
+  ++depth;
+  pre.put(object ? '{' : '[');
+  for (bool first = true; i != end; i = next(i), first = false) {
+    printSeparator<_Policy>(pre, depth, !first);
+    if (object) {
+      printString<_Policy::ascii>(pre, string(i));
+      i += 2;
+      if constexpr (_Policy::indent > 0) {
+        pre.write(": ", 2);
+      } else {
+        pre.put(':');
+      }
+    }
+    printValue<_Policy>(pre, i, depth);
+  }
+  printSeparator<_Policy>(pre, depth - 1, false);
+  pre.put(object ? '}' : ']');
+}
+
+YJson::Type YJson::Tape::Value::type() const {
+  switch (_tape->tag(_index)) {
+    case Null:
+      return YJson::Null;
+    case False:
+      return YJson::False;
+    case True:
+      return YJson::True;
+    case String:
+      return YJson::String;
+    case Array:
+      return YJson::Array;
+    case Object:
+      return YJson::Object;
+    default:
+      return YJson::Number;
+  }
+}
+
+double YJson::Tape::Value::getValueDouble() const {
+  const uint64_t bits = _tape->_words[_index + 1];
+  switch (_tape->tag(_index)) {
+    case Int64: return static_cast<double>(static_cast<int64_t>(bits));
+    case UInt64: return static_cast<double>(bits);
+    default: return std::bit_cast<double>(bits);
+  }
+}
+
+size_t YJson::Tape::Value::size() const {
+  if (!isArray() && !isObject()) {
+    throw std::logic_error("YJson Error: YJson instance type is not YJson::Array.");
+  }
+  return _tape->count(_index);
+}
+
+YJson::Tape::Iterator YJson::Tape::Value::begin() const {
+  if (!isArray() && !isObject()) {
+    throw std::logic_error("YJson Error: YJson instance type is not YJson::Array.");
+  }
+  return Iterator(_tape, _index + 1, isObject());
+}
+
+YJson::Tape::Iterator YJson::Tape::Value::end() const {
+  return Iterator(_tape, _tape->payload(_index) - 1, isObject());
+}
+
+std::optional<YJson::Tape::Value> YJson::Tape::Value::find(std::u8string_view key) const {
+  if (!isObject()) {
+    throw std::logic_error("YJson Error: YJson instance type is not YJson::Object.");
+  }
+  for (size_t i = _index + 1; _tape->tag(i) != EndObject; i = _tape->next(i + 2)) {
+    if (_tape->string(i) == key)
+      return Value(_tape, i + 2);
+  }
+  return std::nullopt;
+}
+
+YJson::Tape::Value YJson::Tape::Value::operator[](std::u8string_view key) const {
+  if (const auto value = find(key))
+    return *value;
+  throw std::runtime_error("YJson Error: Key does not exist.");
+}
+
+YJson::Tape::Value YJson::Tape::Value::operator[](size_t index) const {
+  auto i = begin();
+  for (const auto last = end(); i != last && index; --index)
+    ++i;
+  if (i == end()) {
+    throw std::runtime_error("YJson Error: Index out of range.");
+  }
+  return *i;
+}
+
+std::u8string YJson::Tape::Value::toString(bool fmt) const {
+  std::u8string result;
+  StringSink sink(result);
+  if (fmt) {
+    _tape->printValue<Pretty>(sink, _index, 0);
+  } else {
+    _tape->printValue<Compact>(sink, _index, 0);
+  }
+  return result;
+}
+
+namespace {
+
+unsigned workerCount(unsigned threads) {
+  return threads ? threads : std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// Calls parse(i) for each of `count` chunks on up to `threads` threads, and
+// deliver(i) on this thread in chunk order as soon as chunk i is parsed. parse
+// must not throw. Once deliver returns false or throws, the rest are dropped.
+template <typename Parse, typename Deliver>
+void parseChunks(size_t count, unsigned threads, Parse parse, Deliver deliver) {
+  threads = std::min<size_t>(threads, count);
+  if (threads <= 1) {
+    for (size_t i = 0; i != count; ++i) {
+      parse(i);
+      if (!deliver(i)) return;
+    }
+    return;
+  }
+
+  std::atomic<size_t> nextChunk = 0;
+  std::atomic<bool> stop = false;
+  std::mutex mutex;
+  std::condition_variable finished;
+  std::vector<char> done(count);
+  const auto work = [&] {
+    for (size_t i; !stop && (i = nextChunk++) < count; ) {
+      parse(i);
+      std::lock_guard<std::mutex> lock(mutex);
+      done[i] = true;
+      finished.notify_all();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  struct Joiner {
+    std::atomic<bool>& stop;
+    std::vector<std::thread>& workers;
+    ~Joiner() {
+      stop = true;
+      for (auto& worker: workers) worker.join();
+    }
+  } joiner { stop, workers };
+  for (unsigned i = 0; i != threads; ++i) {
+    workers.emplace_back(work);
+  }
+
+  for (size_t i = 0; i != count; ++i) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      finished.wait(lock, [&done, i] { return done[i]; });
+    }
+    if (!deliver(i)) return;
+  }
+}
+
+}  // namespace
+
+// A run of whole lines for one worker. Line numbers are local to the chunk
+// until the chunks are handed out in order.
+struct YJson::LineChunk {
+  const char8_t* first;
+  const char8_t* last;
+  std::vector<YJson> values;
+  std::vector<size_t> lines;
+  size_t lineCount = 0;
+  size_t errorLine = 0;
+  std::string error;
+};
+
+void YJson::parseLineChunk(LineChunk& chunk) {
+  const char8_t* first = chunk.first;
+  while (first != chunk.last) {
+    auto end = static_cast<const char8_t*>(std::memchr(first, '\n', chunk.last - first));
+    const char8_t* next = end ? end + 1 : chunk.last;
+    if (!end) end = chunk.last;
+    ++chunk.lineCount;
+    auto iter = StrSkip(first, end);
+    if (iter != end) {
+      try {
+        YJson value;
+        iter = StrSkip(value.parseValue(iter, end), end);
+        if (iter != end) {
+          throw std::runtime_error("YJson Error: Unexpected data after the value.");
+        }
+        chunk.values.emplace_back(std::move(value));
+        chunk.lines.push_back(chunk.lineCount);
+      } catch (const std::exception& e) {
+        chunk.errorLine = chunk.lineCount;
+        chunk.error = e.what();
+        return;
+      }
+    }
+    first = next;
+  }
+}
+
+void YJson::parseLines(const char8_t* first, const char8_t* last,
+                       const LineCallback& callback, unsigned threads) {
+  threads = workerCount(threads);
+
+  // Several chunks per thread keep the workers busy when lines differ in size.
+  constexpr size_t minChunkSize = 1 << 16;
+  const size_t chunkSize = std::max(minChunkSize, static_cast<size_t>(last - first) / (threads * 8));
+  std::vector<LineChunk> chunks;
+  for (auto iter = first; iter != last; ) {
+    auto end = iter + std::min(chunkSize, static_cast<size_t>(last - iter));
+    if (end != last) {
+      auto newline = static_cast<const char8_t*>(std::memchr(end, '\n', last - end));
+      end = newline ? newline + 1 : last;
+    }
+    auto& chunk = chunks.emplace_back();
+    chunk.first = iter;
+    chunk.last = end;
+    iter = end;
+  }
+
+  size_t lineBase = 0;
+  parseChunks(chunks.size(), threads, [&chunks](size_t i) {
+    parseLineChunk(chunks[i]);
+  }, [&chunks, &lineBase, &callback](size_t i) {
+    auto& chunk = chunks[i];
+    // The lines before a bad one are delivered first.
+    for (size_t j = 0; j != chunk.values.size(); ++j) {
+      callback(lineBase + chunk.lines[j], std::move(chunk.values[j]));
+    }
+    if (!chunk.error.empty()) {
+      std::string_view message = chunk.error;
+      if (message.starts_with("YJson Error: ")) message.remove_prefix(13);
+      throw std::runtime_error("YJson Error: Line " + std::to_string(lineBase + chunk.errorLine) +
+                               ": " + std::string(message));
+    }
+    lineBase += chunk.lineCount;
+    std::vector<YJson>().swap(chunk.values);
+    return true;
+  });
+}
+
+void YJson::parseLines(const std::filesystem::path& path,
+                       const LineCallback& callback, unsigned threads) {
+#ifdef YJSON_MMAP
+  const MappedFile mapping(path);
+  if (mapping.data()) {
+    parseLines(mapping.data(), mapping.data() + mapping.size(), callback, threads);
+    return;
+  }
+#endif
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("YJson Error: File does not exist.");
+  }
+  const std::u8string json_string = readFile(file);
+  file.close();
+  parseLines(json_string.data(), json_string.data() + json_string.size(), callback, threads);
+}
+
+std::vector<YJson> YJson::parseLines(const char8_t* first, const char8_t* last, unsigned threads) {
+  std::vector<YJson> values;
+  parseLines(first, last, [&values](size_t, YJson&& value) {
+    values.emplace_back(std::move(value));
+  }, threads);
+  return values;
+}
+
+std::vector<YJson> YJson::parseLines(const std::filesystem::path& path, unsigned threads) {
+  std::vector<YJson> values;
+  parseLines(path, [&values](size_t, YJson&& value) {
+    values.emplace_back(std::move(value));
+  }, threads);
+  return values;
+}
+
+// A run of whole elements of a top-level array, between two of its commas.
+struct YJson::ArrayRun {
+  const char8_t* first;
+  const char8_t* last;
+  ArrayType values;
+  bool isLast = false;
+  bool parsed = false;
+};
+
+bool YJson::splitArray(const char8_t* first, const char8_t* last, size_t runSize,
+                       std::vector<ArrayRun>& runs) {
+  const char8_t* runFirst = ++first;
+  const auto target = [&runFirst, last, runSize] {
+    return runSize < static_cast<size_t>(last - runFirst) ? runFirst + runSize : last;
+  };
+  const auto addRun = [&runs, &runFirst](const char8_t* end) -> ArrayRun& {
+    auto& run = runs.emplace_back();
+    run.first = runFirst;
+    run.last = end;
+    runFirst = end + 1;
+    return run;
+  };
+  const char8_t* next = target();
+  size_t depth = 1;
+  for (;;) {
+    const char8_t* stop = first + bracketRun(first, last);
+    // Between brackets and strings at depth 1, every comma separates elements.
+    while (depth == 1 && stop > next) {
+      const char8_t* from = std::max(first, next);
+      auto comma = static_cast<const char8_t*>(std::memchr(from, ',', stop - from));
+      if (!comma)
+        break;
+      addRun(comma);
+      next = target();
+    }
+    if (stop == last)
+      return false;
+
+    switch (*stop) {
+      case '\"':
+        for (++stop; ; stop += 2) {
+          stop += plainRun(stop, last);
+          if (stop == last || last - stop < 2)
+            return false;
+          if (*stop == '\"')
+            break;
+        }
+        break;
+      case '[':
+      case '{':
+        ++depth;
+        break;
+      default:
+        if (--depth == 0) {
+          if (*stop != ']')
+            return false;
+          addRun(stop).isLast = true;
+          return true;
+        }
+        break;
+    }
+    first = stop + 1;
+  }
+}
+
+bool YJson::parseArrayRun(ArrayRun& run) {
+  try {
+    // The same grammar as parseArray, so that it fails wherever that would.
+    // Only the last run may end after a comma.
+    auto first = StrSkip(run.first, run.last);
+    if (first == run.last)
+      return run.isLast;
+    for (;;) {
+      run.values.emplace_back();
+      first = StrSkip(run.values.back().parseValue(first, run.last), run.last);
+      if (first == run.last)
+        return true;
+      if (*first != ',')
+        return false;
+      first = StrSkip(++first, run.last);
+      if (first == run.last)
+        return run.isLast;
+    }
+  } catch (const std::exception&) {
+    return false;
+  }
+}
+
+bool YJson::parseParallel(const char8_t* first, const char8_t* last, unsigned threads) {
+  threads = workerCount(threads);
+  constexpr size_t minRunSize = 1 << 16;
+  const size_t size = last - first;
+  first = StrSkip(first, last);
+  if (threads <= 1 || size < 2 * minRunSize || first == last || *first != '[')
+    return false;
+
+  std::vector<ArrayRun> runs;
+  const size_t runSize = std::max(minRunSize, size / (threads * 8));
+  if (!splitArray(first, last, runSize, runs) || runs.size() < 2)
+    return false;
+
+  // Each run is parsed into its own array, and the runs are moved onto the
+  // result in order once they are all known to be good.
+  bool parsed = true;
+  parseChunks(runs.size(), threads, [&runs](size_t i) {
+    runs[i].parsed = parseArrayRun(runs[i]);
+  }, [&runs, &parsed](size_t i) {
+    return parsed = runs[i].parsed;
+  });
+  if (!parsed)
+    return false;
+  size_t count = 0;
+  for (const auto& run: runs)
+    count += run.values.size();
+  ArrayType buffer;
+  buffer.reserve(count);
+  for (auto& run: runs)
+    std::move(run.values.begin(), run.values.end(), std::back_inserter(buffer));
+  _type = YJson::Array;
+  _value.Array = newContainer(std::move(buffer));
+  return true;
+}
+
+YJson::YJson(Parallel, const char8_t* first, const char8_t* last, unsigned threads): YJson() {
+  if (first >= last) {
+    throw std::logic_error("YJson Error: The iterator range is wrong.");
+  }
+  // Anything that is not a well-formed array is left to the serial parser,
+  // which then reports the error.
+  if (!parseParallel(first, last, threads)) {
+    parseIndexed(first, last);
+  }
+}
+
+YJson::YJson(Parallel, const std::filesystem::path& path, unsigned threads): YJson() {
+#ifdef YJSON_MMAP
+  const MappedFile mapping(path);
+  if (mapping.data()) {
+    YJson(parallel, mapping.data(), mapping.data() + mapping.size(), threads).swap(*this);
+    return;
+  }
+#endif
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("YJson Error: File does not exist.");
+  }
+  const std::u8string json_string = readFile(file);
+  file.close();
+  YJson(parallel, json_string.data(), json_string.data() + json_string.size(), threads).swap(*this);
 }
 
 std::u8string YJson::urlEncode() const {
@@ -58,7 +1632,7 @@ std::u8string YJson::urlEncode() const {
         value.printNumber(param);
         break;
       case YJson::String: {
-        std::u8string str = pureUrlEncode<char8_t>(*value._value.String);
+        std::u8string str = pureUrlEncode<char8_t>(value.stringView());
         param.write(reinterpret_cast<const char*>(str.data()), str.size());
         break;
       }
@@ -94,7 +1668,7 @@ std::u8string YJson::urlEncode(const std::u8string_view url) const {
         value.printNumber(param);
         break;
       case YJson::String: {
-        auto str = pureUrlEncode<char8_t>(*value._value.String);
+        auto str = pureUrlEncode<char8_t>(value.stringView());
         param.write(reinterpret_cast<const char*>(str.data()), str.size());
         break;
       }
@@ -116,6 +1690,18 @@ std::u8string YJson::urlEncode(const std::u8string_view url) const {
   return std::u8string(result.begin(), result.end());
 }
 
+double YJson::parseDecimal(const char* first, const char* last, int64_t magnitude) {
+  double value = 0;
+  const auto result = std::from_chars(first, last, value);
+  if (result.ec == std::errc::result_out_of_range) {
+    return magnitude > 0 ? std::numeric_limits<double>::infinity() : 0.0;
+  }
+  if (result.ec != std::errc() || result.ptr != last) {
+    throw std::runtime_error("YJson Error: Invalid Number.");
+  }
+  return value;
+}
+
 bool YJson::isUtf8BomFile(const std::filesystem::path& path) {
   std::ifstream file(path, std::ios::in | std::ios::binary);
   if (file.is_open()) {
@@ -132,10 +1718,168 @@ bool YJson::isUtf8BomFile(const std::filesystem::path& path) {
   return false;
 }
 
+// An open-addressing table of the first item with each key, probed linearly
+// and at most half full. Later items with the same key are only counted, so
+// that the first one left can be found again when the indexed one goes.
+struct YJson::IndexedObject: SharedContainer<ObjectType> {
+  struct Slot {
+    size_t hash;
+    ObjectIterator item;
+  };
+
+  IndexedObject(ObjectType&& object, const allocator_type& allocator)
+    : SharedContainer<ObjectType>(std::move(object), allocator), slots(allocator) {}
+
+  static size_t hashKey(std::u8string_view key) {
+    return std::hash<std::u8string_view>()(key);
+  }
+
+  bool empty(const Slot& slot) { return slot.item == end(); }
+
+  // The slot holding key, or the empty slot where it would go.
+  Slot& probe(std::u8string_view key, size_t hash) {
+    const size_t mask = slots.size() - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+      Slot& slot = slots[i];
+      if (empty(slot) || (slot.hash == hash && slot.item->first == key))
+        return slot;
+    }
+  }
+
+  void rebuild() {
+    slots.assign(std::max<size_t>(std::bit_ceil(size() * 2), 64), Slot { 0, end() });
+    count = duplicates = 0;
+    for (auto iter = begin(); iter != end(); ++iter)
+      add(iter);
+    stale.store(false, std::memory_order_release);
+  }
+
+  // Lookups go through a const node, which other threads may be reading too,
+  // so the first one after the index went stale rebuilds it under the lock.
+  void refresh() {
+    if (!stale.load(std::memory_order_acquire))
+      return;
+    std::lock_guard<std::mutex> lock(rebuilding);
+    if (stale.load(std::memory_order_relaxed))
+      rebuild();
+  }
+
+  void add(ObjectIterator item) {
+    if ((count + 1) * 2 > slots.size())
+      return rebuild();
+    const size_t hash = hashKey(item->first);
+    Slot& slot = probe(item->first, hash);
+    if (empty(slot)) {
+      slot = Slot { hash, item };
+      ++count;
+    } else {
+      ++duplicates;
+    }
+  }
+
+  void remove(ObjectIterator item) {
+    Slot* slot = &probe(item->first, hashKey(item->first));
+    if (slot->item != item) {
+      --duplicates;
+      return;
+    }
+    if (duplicates) {
+      const auto next = std::find_if(begin(), end(), [item](const ObjectItemType& other) {
+        return &other != &*item && other.first == item->first;
+      });
+      if (next != end()) {
+        slot->item = next;
+        --duplicates;
+        return;
+      }
+    }
+    // Shift later slots of the same run back over the hole.
+    const size_t mask = slots.size() - 1;
+    size_t hole = slot - slots.data();
+    for (size_t i = (hole + 1) & mask; !empty(slots[i]); i = (i + 1) & mask) {
+      const size_t home = slots[i].hash & mask;
+      if (((i - home) & mask) >= ((i - hole) & mask)) {
+        slots[hole] = slots[i];
+        hole = i;
+      }
+    }
+    slots[hole].item = end();
+    --count;
+  }
+
+  std::pmr::vector<Slot> slots;
+  size_t count = 0;
+  size_t duplicates = 0;
+  // Set when the keys may have changed behind the index's back, until the
+  // next lookup or insertion builds it again.
+  std::atomic<bool> stale = true;
+  std::mutex rebuilding;
+};
+
+void YJson::indexObject() {
+  if (_storage != Indexed) {
+    if (_value.Object->size() < indexThreshold)
+      return;
+    const auto object = newContainer<IndexedObject>(_value.Object->get_allocator().resource(),
+                                                    std::move(*_value.Object));
+    object->pinned = shared(_value.Object).pinned;
+    object->lent.store(shared(_value.Object).lent.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    deleteContainer(_value.Object);
+    _value.Object = object;
+    _storage = Indexed;
+  }
+  static_cast<IndexedObject*>(_value.Object)->rebuild();
+}
+
+void YJson::dropIndex() {
+  static_cast<IndexedObject*>(_value.Object)->stale.store(true, std::memory_order_relaxed);
+}
+
+void YJson::addToIndex(ObjectIterator item) {
+  if (_storage != Indexed ||
+      static_cast<IndexedObject*>(_value.Object)->stale.load(std::memory_order_relaxed))
+    return indexObject();
+  static_cast<IndexedObject*>(_value.Object)->add(item);
+}
+
+void YJson::unindexItem(ObjectIterator item) {
+  auto& object = *static_cast<IndexedObject*>(_value.Object);
+  if (!object.stale.load(std::memory_order_relaxed))
+    object.remove(item);
+}
+
+YJson::ObjectIterator YJson::findIndexed(std::u8string_view key) const {
+  auto& object = *static_cast<IndexedObject*>(_value.Object);
+  object.refresh();
+  return object.probe(key, IndexedObject::hashKey(key)).item;
+}
+
+void YJson::deleteObject() {
+  if (!release(shared(_value.Object)))
+    return;
+  if (_storage == Indexed)
+    deleteContainer(static_cast<IndexedObject*>(_value.Object));
+  else
+    deleteContainer(_value.Object);
+}
+
+void YJson::cloneContainer() {
+  if (_type == YJson::Array) {
+    ArrayType array(_value.Array->begin(), _value.Array->end());
+    clearData();
+    _value.Array = newContainer(std::move(array));
+  } else {
+    ObjectType object(_value.Object->begin(), _value.Object->end());
+    clearData();
+    setObject(newContainer(std::move(object)));
+  }
+}
+
 YJson& YJson::joinA(const YJson& js) {
   assert(isArray() && js.isArray());
   if (&js == this)
     return joinA(YJson(*this));
+  detach();
   _value.Array->insert(_value.Array->end(), js._value.Array->begin(), js._value.Array->end());
   return *this;
 }
@@ -144,7 +1888,9 @@ YJson& YJson::joinO(const YJson& js) {
   assert(isObject() && js.isObject());
   if (&js == this)
     return joinO(YJson(*this));
+  detach();
   _value.Object->insert(_value.Object->end(), js._value.Object->begin(), js._value.Object->end());
+  indexObject();
   return *this;
 }
 
@@ -152,174 +1898,112 @@ YJson& YJson::join(const YJson& js) {
   return isArray() ? joinA(js) : joinO(js);
 }
 
-void YJson::printValue(std::ostream& pre, int depth) const {
-  switch (_type) {
-    case YJson::Null:
-      pre.write("null", 4);
-      break;
-    case YJson::False:
-      pre.write("false", 5);
-      break;
-    case YJson::True:
-      pre.write("true", 4);
-      break;
-    case YJson::Number:
-      printNumber(pre);
-      break;
-    case YJson::String:
-      printString(pre, *_value.String);
-      break;
-    case YJson::Array:
-      printArray(pre, depth);
-      break;
-    case YJson::Object:
-      printObject(pre, depth);
-      break;
-    default:
-      throw std::runtime_error("YJson Error: Unknown yjson type.");
-  }
+std::ostream& operator<<(std::ofstream& out, const YJson& outJson) {
+  outJson.print<YJson::Pretty>(out);
+  return out << std::endl;
 }
 
-void YJson::printString(std::ostream& pre, const std::u8string_view str) {
-  pre.put('\"');
-  if (str.empty()) {
-    pre.put('\"');
-    return;
-  }
-
-  constexpr auto cmp = [](char8_t c) -> bool {
-    return c < 32 || c == u8'\"' || c == u8'\\';
-  };
-
-  if (std::find_if(str.begin(), str.end(), cmp) == str.end()) {
-    pre.write(reinterpret_cast<const char*>(str.data()), str.size());
-    pre.put('\"');
-    return;
-  }
+std::ostream& operator<<(std::ostream& out, const YJson& outJson) {
+  outJson.print<YJson::Pretty>(out);
+  return out << std::endl;
+}
 
-  for (const auto c : str) {
-    if (cmp(c)) {
-      pre.put('\\');
-      switch (c) {
-        case '\\':
-          pre.put('\\');
-          break;
-        case '\"':
-          pre.put('\"');
-          break;
-        case '\b':
-          pre.put('b');
-          break;
-        case '\f':
-          pre.put('f');
-          break;
-        case '\n':
-          pre.put('n');
-          break;
-        case '\r':
-          pre.put('r');
-          break;
-        case '\t':
-          pre.put('t');
-          break;
-        default:
-          pre.put('u');
-          pre << std::hex << std::setw(4) << std::setfill('0')
-              << static_cast<uint16_t>(c) << std::setbase(10);
-          break;
-      }
-    } else {
-      pre.put(c);
+void YJson::FileSink::writeAll(const char* data, size_t size) {
+  while (size) {
+#ifdef _WIN32
+    const int written = ::_write(_fd, data, static_cast<unsigned>(std::min<size_t>(size, 1 << 30)));
+#else
+    const ssize_t written = ::write(_fd, data, size);
+#endif
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      throw std::system_error(errno, std::generic_category(), "YJson Error: Write to file failed");
     }
+    data += written;
+    size -= written;
+    _written += written;
   }
-  pre.put('\"');
 }
 
-void YJson::printArray(std::ostream& pre) const {
-  if (_value.Array->empty()) {
-    pre.write("[]", 2);
-    return;
+YJson::AtomicFile::AtomicFile(const std::filesystem::path& target) : _target(target) {
+  std::error_code error;
+  if (std::filesystem::is_symlink(target, error)) {
+    const auto resolved = std::filesystem::canonical(target, error);
+    if (!error)
+      _target = resolved;
+  }
+  // Beside the target, so that the rename stays on one file system.
+  static std::atomic<uint64_t> counter;
+  for (int attempt = 0; attempt != 100; ++attempt) {
+    const uint64_t salt = std::chrono::steady_clock::now().time_since_epoch().count() +
+                          counter.fetch_add(1) * 0x9E3779B97F4A7C15;
+    char name[24] = {'.'};
+    *std::to_chars(name + 1, name + sizeof name - 1, salt, 36).ptr = 0;
+    _path = _target;
+    _path += name;
+    _path += ".tmp";
+#ifdef _WIN32
+    _fd = ::_wopen(_path.c_str(), _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY,
+                   _S_IREAD | _S_IWRITE);
+#else
+    _fd = ::open(_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+#endif
+    if (_fd >= 0 || errno != EEXIST)
+      break;
   }
-  pre.put('[');
-  auto i = _value.Array->begin(), j = _value.Array->end();
-  for (--j; i != j; ++i) {
-    i->printValue(pre);
-    pre.put(',');
+  if (_fd < 0) {
+    const int code = errno;
+    _path.clear();
+    throw std::system_error(code, std::generic_category(), "YJson Error: Cannot create file");
   }
-  i->printValue(pre);
-  pre.put(']');
+#ifndef _WIN32
+  struct stat st;
+  if (::stat(_target.c_str(), &st) == 0)
+    ::fchmod(_fd, st.st_mode & 07777);
+#endif
 }
 
-void YJson::printArray(std::ostream& pre, int depth) const {
-  constexpr int depthTimes = 2;
-  if (_value.Array->empty()) {
-    pre.write("[]", 2);
-    return;
-  }
-  ++depth;
-  pre.write("[\n", 2);
-  auto i = _value.Array->begin(), j = _value.Array->end();
-  for (--j; i != j; ++i) {
-    pre << std::string(depth << depthTimes, ' ');
-    i->printValue(pre, depth);
-    pre.write(",\n", 2);
-  }
-  pre << std::string(depth << depthTimes, ' ');
-  i->printValue(pre, depth);
-  pre.put('\n');
-  pre << std::string(--depth << depthTimes, ' ');
-  pre.put(']');
-}
-
-void YJson::printObject(std::ostream& pre) const {
-  if (_value.Object->empty()) {
-    pre.write("{}", 2);
-    return;
+YJson::AtomicFile::~AtomicFile() {
+  if (_fd >= 0) {
+#ifdef _WIN32
+    ::_close(_fd);
+#else
+    ::close(_fd);
+#endif
   }
-  pre.put('{');
-  auto i = _value.Object->begin(), j = _value.Object->end();
-  for (--j; j != i; ++i) {
-    printString(pre, i->first);
-    pre.put(':');
-    i->second.printValue(pre);
-    pre.put(',');
+  if (!_path.empty()) {
+    std::error_code error;
+    std::filesystem::remove(_path, error);
   }
-  printString(pre, i->first);
-  pre.put(':');
-  i->second.printValue(pre);
-  pre.put('}');
 }
 
-void YJson::printObject(std::ostream& pre, int depth) const {
-  constexpr int depthTimes = 2;
-  if (_value.Object->empty()) {
-    pre.write("{}", 2);
-    return;
+void YJson::AtomicFile::commit(bool sync) {
+#ifdef _WIN32
+  if (sync && ::_commit(_fd) != 0)
+    throw std::system_error(errno, std::generic_category(), "YJson Error: Cannot sync file");
+  if (::_close(std::exchange(_fd, -1)) != 0)
+    throw std::system_error(errno, std::generic_category(), "YJson Error: Cannot close file");
+#else
+  if (sync && ::fsync(_fd) != 0)
+    throw std::system_error(errno, std::generic_category(), "YJson Error: Cannot sync file");
+  if (::close(std::exchange(_fd, -1)) != 0)
+    throw std::system_error(errno, std::generic_category(), "YJson Error: Cannot close file");
+#endif
+  std::error_code error;
+  std::filesystem::rename(_path, _target, error);
+  if (error)
+    throw std::system_error(error, "YJson Error: Cannot replace file");
+  _path.clear();
+#ifndef _WIN32
+  // The rename itself is only durable once the directory is synced.
+  if (sync) {
+    const auto parent = _target.parent_path();
+    const int dir = ::open(parent.empty() ? "." : parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir >= 0) {
+      ::fsync(dir);
+      ::close(dir);
+    }
   }
-  ++depth;
-  pre.write("{\n", 2);
-  auto i = _value.Object->begin(), j = _value.Object->end();
-  for (--j; i != j; ++i) {
-    pre << std::string(depth << depthTimes, ' ');
-    printString(pre, i->first);
-    pre.write(": ", 2);
-    i->second.printValue(pre, depth);
-    pre.write(",\n", 2);
-  }
-  pre << std::string(depth << depthTimes, ' ');
-  printString(pre, i->first);
-  pre.write(": ", 2);
-  i->second.printValue(pre, depth);
-  pre.put('\n');
-  pre << std::string(--depth << depthTimes, ' ');
-  pre.put('}');
-}
-std::ostream& operator<<(std::ofstream& out, const YJson& outJson) {
-  outJson.printValue(out, 0);
-  return out << std::endl;
-}
-
-std::ostream& operator<<(std::ostream& out, const YJson& outJson) {
-  outJson.printValue(out, 0);
-  return out << std::endl;
+#endif
 }
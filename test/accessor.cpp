@@ -0,0 +1,36 @@
+#include <yjson/yjson.h>
+
+#include <cstdlib>
+
+// The value accessors keep their baseline signatures, whatever the node
+// holds its value in.
+int main()
+{
+  int failures = 0;
+  const auto check = [&failures](bool ok, const char* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++failures;
+    }
+  };
+
+  std::u8string json = u8R"(["short", "a string too long to be inline"])";
+  const auto read = [&check](const YJson& tree) {
+    const std::u8string& inlined = tree[0].getValueString();
+    std::u8string copied = tree[1].getValueString();
+    auto& bound = tree[1].getValueString();
+    check(inlined == u8"short" && copied == u8"a string too long to be inline" && bound == copied,
+          "const getValueString");
+    check(tree[0].getValueString() != tree[1].getValueString(), "const strings compare by value");
+    check(tree[1].getValueStringView() == copied, "getValueStringView");
+  };
+  read(YJson(json.data(), json.data() + json.size()));
+  // Borrowed from the buffer.
+  read(YJson(YJson::inSitu, json));
+
+  YJson tree(YJson::inSitu, json);
+  tree[0].getValueString() += u8" and edited";
+  tree[1].getValueString().clear();
+  check(tree.toString() == u8R"(["short and edited",""])", "mutable getValueString edits the node");
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
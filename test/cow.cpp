@@ -0,0 +1,81 @@
+#include <yjson/yjson.h>
+
+#include <cstdlib>
+#include <thread>
+
+// Copies share containers until one of them changes, and neither ever sees
+// the changes of the other.
+int main()
+{
+  int failures = 0;
+  const auto check = [&failures](bool ok, const char* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++failures;
+    }
+  };
+  const std::u8string json = u8R"({"x":1,"list":[1,2],"inner":{"y":"short","z":[]}})";
+
+  {
+    // References and iterators taken before the copy must not reach it.
+    YJson a(json.data(), json.data() + json.size());
+    YJson& x = a[u8"x"];
+    auto& list = a[u8"list"].getArray();
+    auto inner = a[u8"inner"].beginO();
+    YJson b = a;
+    x = 42;
+    list.push_back(3);
+    inner->second = u8"changed";
+    check(b.toString() == json, "references taken before a copy leave the copy alone");
+    check(a[u8"x"] == 42 && a[u8"list"].sizeA() == 3, "references still change the original");
+  }
+  {
+    // Changes through either copy stay in it.
+    YJson a(json.data(), json.data() + json.size());
+    const YJson b = a;
+    YJson c = a;
+    a[u8"inner"][u8"z"].append(1);
+    c[u8"list"].append(u8"c");
+    check(b.toString() == json, "untouched copy is unchanged");
+    check(a[u8"list"].sizeA() == 2 && c[u8"inner"][u8"z"].emptyA(), "copies do not see each other");
+    YJson d = a;
+    a[u8"inner"][u8"z"].clearA();
+    check(d[u8"inner"][u8"z"].sizeA() == 1, "copies of a changed tree are separate");
+  }
+  {
+    // A tree written through operator[] is still shared with its consumers:
+    // only the first copy after the writes is deep, and only along the path
+    // that was written.
+    YJson config(json.data(), json.data() + json.size());
+    config[u8"inner"][u8"y"] = u8"edited";
+    const YJson first = config;
+    const YJson second = config;
+    const YJson third = config;
+    const auto& shared = std::as_const(config);
+    check(&first[u8"list"].getArray() == &shared[u8"list"].getArray(), "untouched children are shared");
+    check(&second.getObject() == &shared.getObject() && &third.getObject() == &shared.getObject(),
+          "later copies share the written root");
+    check(&second[u8"inner"].getObject() == &third[u8"inner"].getObject(),
+          "later copies share the written path");
+    config[u8"inner"][u8"y"] = u8"again";
+    check(second[u8"inner"][u8"y"] == u8"edited" && third[u8"inner"][u8"y"] == u8"edited",
+          "writes after the copies stay out of them");
+  }
+  {
+    // Readers of shared copies on several threads, through the const accessors.
+    YJson a(json.data(), json.data() + json.size());
+    std::vector<std::thread> threads;
+    std::atomic<int> wrong = 0;
+    for (int i = 0; i != 4; ++i) {
+      threads.emplace_back([copy = a, &wrong]() {
+        const YJson& tree = copy;
+        for (int j = 0; j != 1000; ++j)
+          wrong += tree[u8"inner"][u8"y"].getValueString() != u8"short";
+      });
+    }
+    for (auto& thread: threads)
+      thread.join();
+    check(wrong == 0, "const reads from several threads");
+  }
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
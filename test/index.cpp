@@ -0,0 +1,52 @@
+#include <yjson/yjson.h>
+
+#include <cstdlib>
+#include <thread>
+
+// Large objects find keys through their index, which is built again after
+// the object was handed out through getObject().
+int main()
+{
+  int failures = 0;
+  const auto check = [&failures](bool ok, const char* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++failures;
+    }
+  };
+  const auto key = [](int i) {
+    return u8"key " + YJson(i).toString();
+  };
+
+  constexpr int count = 50000;
+  YJson object(YJson::Object);
+  for (int i = 0; i != count; ++i)
+    object[key(i)] = i;
+
+  // Keys changed and added behind the index's back are found afterwards.
+  int sum = 0;
+  for (auto& [name, value]: object.getObject())
+    sum += value.getValueInt();
+  check(sum != 0, "range-for over getObject");
+  object.getObject().front().first = u8"renamed";
+  object.getObject().emplace_back(u8"added", true);
+  check(object.find(u8"renamed") != object.endO(), "a renamed key is found");
+  check(object.find(key(0)) == object.endO(), "the old key is gone");
+  check(object[u8"added"].isTrue(), "a key added through getObject is found");
+
+  // Lookups from several threads; the first one rebuilds the index.
+  object.getObject();
+  const YJson& tree = object;
+  std::atomic<int> missing = 0;
+  std::vector<std::thread> threads;
+  for (int t = 0; t != 4; ++t) {
+    threads.emplace_back([&tree, &missing, &key]() {
+      for (int i = 1; i != count; ++i)
+        missing += tree[key(i)] != i;
+    });
+  }
+  for (auto& thread: threads)
+    thread.join();
+  check(missing == 0, "every key is found after getObject");
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
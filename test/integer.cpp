@@ -0,0 +1,42 @@
+#include <yjson/yjson.h>
+
+#include <cstdlib>
+
+// Integers keep their exact value through parsing, reading them as doubles
+// through const nodes, copying and printing.
+int main()
+{
+  const std::u8string json = u8"[18446744073709551615,9007199254740993,1700000000000,"
+                             u8"-9223372036854775808,0,-1,2.5]";
+  int failures = 0;
+  const auto check = [&failures](bool ok, const char* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++failures;
+    }
+  };
+
+  YJson array(json.data(), json.data() + json.size());
+  double sum = 0;
+  for (const auto& item: std::as_const(array).getArray())
+    sum += item.getValueDouble();
+  check(sum != 0, "getValueDouble reads the numbers");
+  check(array.toString() == json, "printing after getValueDouble is exact");
+  check(array[0].getValueInt<uint64_t>() == 18446744073709551615u, "uint64 after getValueDouble");
+  check(array[1].getValueInt<int64_t>() == 9007199254740993, "int64 after getValueDouble");
+  check(array[3].getValueInt<int64_t>() == std::numeric_limits<int64_t>::min(), "int64 minimum");
+  check(std::as_const(array)[1].getValueDouble() == 9007199254740992.0, "getValueDouble rounds to nearest");
+
+  const YJson copy = array;
+  check(copy.toString() == json, "copies are exact");
+
+  array[2] = 0.5;
+  check(array[2].getValueDouble() == 0.5, "assigning a double changes the value");
+
+  // A writable double turns the node into a double one.
+  array[4].getValueDouble() = 3.5;
+  ++array[5].getValueDouble();
+  check(array[4].getValueDouble() == 3.5 && array[5].getValueDouble() == 0, "writing through getValueDouble");
+  check(array[0].getValueInt<uint64_t>() == 18446744073709551615u, "other nodes stay exact");
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
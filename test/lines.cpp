@@ -0,0 +1,45 @@
+#include <yjson/yjson.h>
+
+#include <cstdlib>
+
+// A bad line throws only after every line before it has been delivered, in
+// order, however the text is cut into chunks.
+int main()
+{
+  int failures = 0;
+  const auto check = [&failures](bool ok, const char* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++failures;
+    }
+  };
+
+  constexpr size_t goodLines = 20000;
+  for (const size_t badLine: {goodLines + 1, goodLines / 2 + 7}) {
+    std::u8string text;
+    for (size_t line = 1; line <= goodLines + 1; ++line) {
+      if (line == badLine)
+        text += u8"{bad\n";
+      else
+        text += u8"{\"line\": " + YJson(static_cast<int>(line)).toString() + u8"}\n";
+    }
+    for (unsigned threads: {1u, 2u, 4u}) {
+      size_t delivered = 0;
+      bool ordered = true;
+      std::string error;
+      try {
+        YJson::parseLines(text.data(), text.data() + text.size(), [&](size_t line, YJson&& value) {
+          ++delivered;
+          ordered = ordered && line == delivered && value[u8"line"] == static_cast<int>(line);
+        }, threads);
+      } catch (const std::runtime_error& e) {
+        error = e.what();
+      }
+      check(delivered == badLine - 1, "every line before the bad one is delivered");
+      check(ordered, "lines are delivered in order");
+      check(error.find("Line " + std::to_string(badLine) + ":") != std::string::npos,
+            "the error gives the bad line");
+    }
+  }
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
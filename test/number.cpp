@@ -0,0 +1,96 @@
+#include <yjson/yjson.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+
+// The pow-based routine that parseNumber replaced, kept for comparison.
+static const char8_t* legacyParseNumber(const char8_t* first, const char8_t* last, double& buffer) {
+  buffer = 0;
+  int sign = 1, scale = 0, signsubscale = 1, subscale = 0;
+  if (*first == '-') {
+    sign = -1;
+    ++first;
+  }
+  if (*first == '0')
+    return ++first;
+  for (; first != last && isdigit(*first); ++first)
+    buffer = buffer * 10 + (*first - '0');
+  if (first != last && *first == '.') {
+    for (++first; first != last && isdigit(*first); ++first, --scale)
+      buffer = buffer * 10 + (*first - '0');
+  }
+  if (first != last && (*first == 'e' || *first == 'E')) {
+    if (*++first == '-') {
+      signsubscale = -1;
+      ++first;
+    } else if (*first == '+') {
+      ++first;
+    }
+    for (; first != last && isdigit(*first); ++first)
+      subscale = subscale * 10 + (*first - '0');
+  }
+  buffer *= sign * pow(10, scale + signsubscale * subscale);
+  return first;
+}
+
+int main()
+{
+  // Coordinates and metrics: short decimals with a few long ones and exponents.
+  std::mt19937_64 random(42);
+  std::vector<std::u8string> numbers;
+  for (int i = 0; i != 1000000; ++i) {
+    char text[32];
+    switch (i % 4) {
+      case 0: snprintf(text, sizeof text, "%.6f", std::uniform_real_distribution<>(-180, 180)(random)); break;
+      case 1: snprintf(text, sizeof text, "%d", static_cast<int>(random() % 100000)); break;
+      case 2: snprintf(text, sizeof text, "%.17g", std::uniform_real_distribution<>(1, 2)(random)); break;
+      default: snprintf(text, sizeof text, "%.3e", std::uniform_real_distribution<>(0, 1e10)(random)); break;
+    }
+    numbers.emplace_back(reinterpret_cast<const char8_t*>(text));
+  }
+
+  std::u8string json = u8"[";
+  for (const auto& number: numbers) {
+    json += number;
+    json += u8',';
+  }
+  json.back() = u8']';
+
+  // Both read the same array; the legacy routine only skips to the next comma,
+  // as it stops early on numbers such as 0.5.
+  struct Collector: YJson::SaxHandler {
+    std::vector<double> values;
+    bool onNumber(double value) { values.push_back(value); return true; }
+  };
+  // Returns how many values differ from strtod.
+  const auto run = [&numbers](const char* name, auto parse) {
+    Collector collector;
+    collector.values.reserve(numbers.size());
+    const auto start = std::chrono::steady_clock::now();
+    parse(collector);
+    const std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+    size_t wrong = 0;
+    for (size_t i = 0; i != numbers.size(); ++i) {
+      wrong += collector.values[i] != std::strtod(reinterpret_cast<const char*>(numbers[i].c_str()), nullptr);
+    }
+    std::cout << name << ": " << time.count() << " ms, " << wrong << " of " << numbers.size() << " wrong\n";
+    return wrong;
+  };
+
+  run("legacy", [&json](Collector& collector) {
+    const char8_t* first = json.data() + 1;
+    const char8_t* last = json.data() + json.size();
+    for (double value; first < last; ++first) {
+      first = legacyParseNumber(first, last, value);
+      collector.onNumber(value);
+      while (first < last && *first != ',')
+        ++first;
+    }
+  });
+  const size_t wrong = run("YJson", [&json](Collector& collector) {
+    YJson::saxParse(json.data(), json.data() + json.size(), collector);
+  });
+  return wrong == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,40 @@
+#include <yjson/yjson.h>
+
+#include <cstdlib>
+
+// Feeds each document to a PushParser in chunks of every size up to 8 bytes,
+// and checks the result against the DOM parser.
+int main()
+{
+  std::vector<std::u8string> documents {
+    u8R"({"name": "yjson", "tags": ["json", "c++"], "size": 16, "ok": true, "none": null})",
+    u8R"([1, -2, 3.25, 1e-7, -0.0, 18446744073709551615, 9223372036854775807, -9223372036854775808])",
+    u8R"(["plain", "esc\"aped\\", "é中😀", "tab\tline\n", ""])",
+    u8R"({"a": {"b": {"c": [[], {}, [[[]]], {"d": [false]}]}}})",
+    u8"  \"top-level string\"  ",
+    u8"-12.5e3",
+    u8"true",
+  };
+  std::u8string wide = u8"{";
+  for (int i = 0; i != 40; ++i)
+    wide += u8"\"key " + YJson(i).toString() + u8"\": " + YJson(i * 3).toString() + u8", ";
+  wide += u8"\"last\": []}";
+  documents.push_back(wide);
+
+  int failures = 0;
+  YJson::PushParser parser;
+  for (const auto& document: documents) {
+    const YJson expected(document.data(), document.data() + document.size());
+    for (size_t chunk = 1; chunk <= 8; ++chunk) {
+      for (size_t i = 0; i < document.size(); i += chunk)
+        parser.feed(document.data() + i, std::min(chunk, document.size() - i));
+      const YJson value = parser.finish();
+      if (value != expected || value.toString() != expected.toString()) {
+        std::cerr << "chunks of " << chunk << " differ on: "
+                  << reinterpret_cast<const char*>(document.c_str()) << '\n';
+        ++failures;
+      }
+    }
+  }
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
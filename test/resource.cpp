@@ -0,0 +1,78 @@
+#include <yjson/yjson.h>
+
+#include <cstdlib>
+
+// Trees built in a memory resource give back everything they take from it,
+// unless it is an Arena, which keeps their text until it is reset.
+struct Counting: std::pmr::memory_resource {
+  size_t live = 0;
+
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    live += bytes;
+    return ::operator new(bytes, std::align_val_t(alignment));
+  }
+  void do_deallocate(void* data, size_t bytes, size_t alignment) override {
+    live -= bytes;
+    ::operator delete(data, bytes, std::align_val_t(alignment));
+  }
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+int main()
+{
+  int failures = 0;
+  const auto check = [&failures](bool ok, const char* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++failures;
+    }
+  };
+
+  std::u8string json = u8"[";
+  for (int i = 0; i != 20; ++i) {
+    json += u8R"({"a rather long key for the table": "a value too long to be inline",)"
+            u8R"( "another long key, this one escaped\n": ["short", "longer than fourteen bytes"]},)";
+  }
+  json += u8"{";
+  for (int i = 0; i != 40; ++i)
+    json += u8"\"a key of an indexed object " + YJson(i).toString() + u8"\": \"and its long value\", ";
+  json += u8R"("end": null}])";
+  const YJson expected(json.data(), json.data() + json.size());
+
+  {
+    Counting counting;
+    {
+      YJson tree(&counting, json.data(), json.data() + json.size());
+      check(tree == expected, "tree in a resource");
+      tree[0][u8"a new key that is long enough"] = u8"and a new value that is long enough";
+      tree[0].append(u8"appended value, long enough", u8"appended key that is long enough");
+      check(counting.live != 0, "containers come from the resource");
+    }
+    check(counting.live == 0, "a tree gives back everything it takes from a resource");
+  }
+  {
+    Counting upstream;
+    YJson::KeyTable table(&upstream);
+    {
+      YJson tree(&table, json.data(), json.data() + json.size());
+      check(tree == expected, "tree in a key table");
+      check(table.size() == 42, "repeated keys are interned once");
+      const YJson copy(&table, tree);
+      check(copy == expected, "copy into a key table");
+    }
+    check(upstream.live == 0, "a tree gives back everything it takes from a key table");
+  }
+  {
+    YJson copy;
+    {
+      YJson::Arena arena(256);
+      YJson tree(&arena, json.data(), json.data() + json.size());
+      check(tree == expected, "tree in an arena");
+      copy = tree;
+    }
+    check(copy == expected, "a copy of a tree in an arena outlives the arena");
+  }
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -10,6 +10,9 @@ add_includedirs("include")
 target("yjson")
   set_kind("static")
   add_files("src/yjson.cpp")
+  if is_plat("linux") then
+    add_syslinks("pthread")
+  end
 target_end()
 
 target("yjson_test")